@@ -0,0 +1,78 @@
+#version 450
+
+// Vertex pulling: the arrays of the mesh are read as they are stored on the CPU and gl_VertexIndex is a facet corner,
+// the index buffer holds the triangulation of the facets
+layout(constant_id = 0) const uint ARITY = 0; // Corners per facet, 0 when facetOffset gives the facets
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) flat out vec3 outColor;
+layout(location = 3) out vec3 outPosition;
+layout(location = 4) flat out uint outFlatNormal;
+
+layout(binding = 0) uniform Camera {
+	vec3 center;
+	vec3 u, v, w;
+} cam;
+
+// Points and normals are tightly packed vec3 which std430 would align on 16 bytes
+layout(set = 1, binding = 0, std430) readonly buffer Points { float points[]; };
+layout(set = 1, binding = 1, std430) readonly buffer FacetVertices { uint facetVertices[]; };
+layout(set = 1, binding = 2, std430) readonly buffer FacetOffset { uint facetOffset[]; };
+layout(set = 1, binding = 3, std430) readonly buffer CornerUVs { vec2 cornerUVs[]; };
+layout(set = 1, binding = 4, std430) readonly buffer VertexNormals { float vertexNormals[]; };
+
+layout(push_constant) uniform Object {
+	vec3 origin;
+	vec3 extent;
+	uint nfacets;
+	uint nuvs; // Corners with texture coordinates
+	uint smoothNormals; // vertexNormals holds a normal per point
+	uint pointVertices;
+	vec3 color;
+} obj;
+
+#define PI 3.14159265359
+
+vec3 point(uint v) { return vec3(points[3*v], points[3*v+1], points[3*v+2]); }
+
+// Facet of corner fc, the last f such that facetOffset[f] <= fc
+uint facetOf(uint fc) {
+	uint lo = 0, hi = obj.nfacets;
+	while(hi - lo > 1) {
+		const uint mid = (lo + hi) / 2;
+		if(facetOffset[mid] <= fc) lo = mid;
+		else hi = mid;
+	}
+	return lo;
+}
+
+void main() {
+	const uint fc = uint(gl_VertexIndex);
+	const uint v = facetVertices[fc];
+	const vec3 p = point(v);
+
+	if(obj.smoothNormals != 0) outNormal = vec3(vertexNormals[3*v], vertexNormals[3*v+1], vertexNormals[3*v+2]);
+	else {
+		// Normal of the corner like packFlatNormals, from its previous and next corners in the facet
+		uint begin, end;
+		if(ARITY != 0) {
+			begin = fc - fc % ARITY;
+			end = begin + ARITY;
+		} else {
+			const uint f = facetOf(fc);
+			begin = facetOffset[f];
+			end = facetOffset[f+1];
+		}
+		const uint prev = fc == begin ? end - 1 : fc - 1;
+		const uint next = fc + 1 == end ? begin : fc + 1;
+		outNormal = cross(point(facetVertices[prev]) - p, point(facetVertices[next]) - p);
+	}
+	outUV = fc < obj.nuvs ? cornerUVs[fc] : vec2(0.0);
+	outColor = obj.color;
+
+	const vec3 q = p - cam.center;
+	outPosition = q;
+	outFlatNormal = 0;
+	gl_Position = vec4(dot(cam.u, q), -dot(cam.v, q), atan(dot(cam.w, q)) / PI + .5, 1.0);
+}
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 layout(location = 0) in vec3 normal;
 layout(location = 1) in vec2 inUV;
+layout(location = 2) flat in vec3 surfaceColor;
+layout(location = 3) in vec3 position;
+layout(location = 4) flat in uint flatNormal;
 
 layout(location = 0) out vec4 outColor;
 
@@ -12,7 +15,13 @@ layout(binding = 0) uniform Camera {
 
 void main() {
     vec2 uv = inUV - round(inUV);
-    vec3 color = vec3(0.65 * pow(max(0., dot(normal, cam.w) / length(normal)), 1.5));
+    // Flat normal of the triangle for the vertices shared by the corners of a point, oriented like their smooth normal
+    vec3 n = normal;
+    if(flatNormal != 0) {
+        const vec3 f = cross(dFdx(position), dFdy(position));
+        n = dot(f, normal) < 0. ? -f : f;
+    }
+    vec3 color = surfaceColor * pow(max(0., dot(n, cam.w) / length(n)), 1.5);
     if(abs(uv.x) < .1 || abs(uv.y) < .1) color *= 0.11;
     outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,22 +1,50 @@
 #version 450
 
+// Compact vertices (see geometry/compact.h): positions in [0, 1] relative to the bounding box of the object
+// and octahedral normals, the uv format is read as floats in both layouts
+layout(constant_id = 0) const bool COMPACT_VERTICES = false;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
 
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 outUV;
+layout(location = 2) flat out vec3 outColor;
+layout(location = 3) out vec3 outPosition;
+layout(location = 4) flat out uint outFlatNormal;
 
 layout(binding = 0) uniform Camera {
 	vec3 center;
 	vec3 u, v, w;
 } cam;
 
+// ObjectConstants of the objects drawn in the frame, the draws give the index of their object as first instance
+struct Object {
+	vec3 origin; // Quantization of the positions, identity for full vertices
+	vec3 extent;
+	uint nfacets, nuvs, smoothNormals;
+	uint pointVertices; // Vertices shared by the corners of a point, they hold its smooth normal
+	vec3 color;
+};
+layout(set = 1, binding = 0, std430) readonly buffer Objects { Object objects[]; };
+
 #define PI 3.14159265359
 
+vec3 octahedralDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
 void main() {
-	vec3 p = inPosition - cam.center;
+	const Object obj = objects[gl_InstanceIndex];
+	vec3 p = obj.origin + obj.extent * inPosition - cam.center;
 	gl_Position = vec4(dot(cam.u, p), -dot(cam.v, p), atan(dot(cam.w, p)) / PI + .5, 1.0);
-	outNormal = inNormal;
+	outNormal = COMPACT_VERTICES ? octahedralDecode(inNormal.xy) : inNormal;
 	outUV = inUV;
+	outColor = obj.color;
+	outPosition = p;
+	outFlatNormal = obj.pointVertices != 0 && obj.smoothNormals == 0 ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Loader benchmark: generates synthetic meshes then times readMesh, triangulation, normal generation, vertex packing
+// encoding of the compact vertex format and meshlet building.
+// Results are written as JSON on the standard output (or in the file given by --output).
+//
+// Usage: VisuBench [--min-facets N] [--max-facets N] [--repeat N] [--dir DIR] [--filter SUBSTRING] [--output FILE]
+// The sizes go from 1K to 100M facets by default, the largest files take several GB in DIR.
+
+#include "generator.h"
+
+#include <loader.h>
+#include <geometry/compact.h>
+#include <geometry/lod.h>
+#include <geometry/meshlets.h>
+#include <geometry/normals.h>
+#include <geometry/triangulation.h>
+#include <parallel.h>
+#include <simd.h>
+#include <timer.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#if __has_include(<sys/resource.h>)
+	#include <sys/resource.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct Options {
+	size_t min_facets = 1'000;
+	size_t max_facets = 100'000'000;
+	int repeat = 1;
+	string dir = BUILD_DIR "/bench";
+	string filter;
+	string output;
+};
+
+// Peak resident set size in bytes, since the last call to resetPeakRSS when the system supports it
+size_t peakRSS() {
+	ifstream status("/proc/self/status");
+	string line;
+	while(getline(status, line))
+		if(line.starts_with("VmHWM:")) return 1024 * stoull(line.substr(6));
+#if __has_include(<sys/resource.h>)
+	rusage usage;
+	if(!getrusage(RUSAGE_SELF, &usage)) return 1024 * size_t(usage.ru_maxrss);
+#endif
+	return 0;
+}
+
+void resetPeakRSS() {
+	ofstream clear("/proc/self/clear_refs");
+	if(clear) clear << "5";
+}
+
+// Smallest duration of `repeat` runs of `fun`
+template<typename Fun>
+double bestTime(const int repeat, const Fun &fun) {
+	double best = numeric_limits<double>::infinity();
+	for(int r = 0; r < repeat; ++r) {
+		Timer timer;
+		fun();
+		best = min(best, timer.elapsed());
+	}
+	return best;
+}
+
+struct Case {
+	Shape shape;
+	bool mixed;
+	size_t facets;
+	const char* format;
+
+	string name() const {
+		return string(shape == Shape::SPHERE ? "sphere" : "grid") + (mixed ? "_mixed_" : "_tri_") + to_string(facets) + "." + format;
+	}
+};
+
+void runCase(const Case &c, const Options &opt, ostream &json) {
+	const string path = opt.dir + "/" + c.name();
+	if(!fs::exists(path)) {
+		cerr << "Generating " << path << endl;
+		const Mesh m = generateMesh(c.shape, c.facets, c.mixed);
+		if(!strcmp(c.format, "obj")) writeOBJ(path.c_str(), m);
+		else writePLY(path.c_str(), m);
+	}
+	const size_t bytes = fs::file_size(path);
+	cerr << "Running " << c.name() << endl;
+
+	resetPeakRSS();
+	Mesh read;
+	const double readTime = bestTime(opt.repeat, [&]() { read = readMesh(path.c_str(), false); });
+	const size_t nverts = read.nverts(), nfacets = read.nfacets(), ncorners = read.nfacet_corners();
+	Timer timer;
+	const AnyMesh mesh = specializeMesh(std::move(read));
+	const double specialization = timer.elapsed();
+
+	// Per corner stages run on the specialized mesh type like in the viewer
+	double adjacency, normal, triangulation, flat, smooth, encoding, clustering, simplification;
+	size_t ntriangles, nmeshlets, nlods, coarsest;
+	std::visit([&](const auto &m) {
+		VertexCorners corners;
+		adjacency = bestTime(opt.repeat, [&]() { corners = buildVertexCorners(m); });
+		vector<vec3> normals;
+		normal = bestTime(opt.repeat, [&]() { normals = computeSmoothNormals(m, corners); });
+		vector<uint32_t> triangles;
+		triangulation = bestTime(opt.repeat, [&]() { triangles = triangulateFacets(m, 0, m.nfacets()); });
+		ntriangles = triangles.size() / 3;
+		// The builder reorders the triangles, every run starts from the triangulation order
+		clustering = bestTime(opt.repeat, [&]() {
+			vector<uint32_t> reordered = triangles;
+			nmeshlets = buildMeshlets(m, reordered).size();
+		});
+		vector<Lod> lods;
+		simplification = bestTime(opt.repeat, [&]() { lods = buildLods(m, triangles); });
+		nlods = lods.size();
+		coarsest = lods.empty() ? ntriangles : lods.back().indices.size() / 3;
+		vector<vec3f> positions(m.nfacet_corners()), vertexNormals(m.nfacet_corners());
+		vector<vec2f> uvs(m.nfacet_corners());
+		const auto pack = [&](const bool smooth) {
+			packPositions(m, 0, m.nfacets(), positions.data());
+			if(smooth) packSmoothNormals(m, normals, 0, m.nfacets(), vertexNormals.data());
+			else packFlatNormals(m, 0, m.nfacets(), vertexNormals.data());
+			packUVs(m, 0, m.nfacets(), uvs.data());
+		};
+		flat = bestTime(opt.repeat, [&]() { pack(false); });
+		smooth = bestTime(opt.repeat, [&]() { pack(true); });
+		// Encoding of the packed streams in parallel like in the viewer
+		const Quantization q = quantization(m);
+		vector<unorm16x4> compactPositions(m.nfacet_corners());
+		vector<snorm16x2> compactNormals(m.nfacet_corners());
+		vector<half2> compactUVs(m.nfacet_corners());
+		encoding = bestTime(opt.repeat, [&]() {
+			parallelRanges(m.nfacet_corners(), [&](size_t, const size_t begin, const size_t end) {
+				encodePositions(positions.data() + begin, end - begin, q, compactPositions.data() + begin);
+				encodeNormals(vertexNormals.data() + begin, end - begin, compactNormals.data() + begin);
+				encodeUVs(uvs.data() + begin, end - begin, compactUVs.data() + begin);
+			});
+		});
+	}, mesh);
+	const double vertexBytes = (2 * sizeof(vec3f) + sizeof(vec2f)) * ncorners;
+	const double compactBytes = (sizeof(unorm16x4) + sizeof(snorm16x2) + sizeof(half2)) * ncorners;
+	const char* meshTypes[] { "triangles", "quads", "polygons" };
+
+	json << "\t\t{\n"
+		<< "\t\t\t\"name\": \"" << c.name() << "\",\n"
+		<< "\t\t\t\"shape\": \"" << (c.shape == Shape::SPHERE ? "sphere" : "grid") << "\",\n"
+		<< "\t\t\t\"polygons\": \"" << (c.mixed ? "mixed" : "triangles") << "\",\n"
+		<< "\t\t\t\"format\": \"" << c.format << "\",\n"
+		<< "\t\t\t\"file_bytes\": " << bytes << ",\n"
+		<< "\t\t\t\"vertices\": " << nverts << ",\n"
+		<< "\t\t\t\"facets\": " << nfacets << ",\n"
+		<< "\t\t\t\"corners\": " << ncorners << ",\n"
+		<< "\t\t\t\"mesh_type\": \"" << meshTypes[mesh.index()] << "\",\n"
+		<< "\t\t\t\"read\": { \"time\": " << readTime << ", \"bytes_per_second\": " << bytes / readTime
+			<< ", \"facets_per_second\": " << nfacets / readTime << " },\n"
+		<< "\t\t\t\"specialization\": { \"time\": " << specialization << " },\n"
+		<< "\t\t\t\"triangulation\": { \"time\": " << triangulation << ", \"triangles\": " << ntriangles
+			<< ", \"facets_per_second\": " << nfacets / triangulation << " },\n"
+		<< "\t\t\t\"vertex_corners\": { \"time\": " << adjacency << ", \"corners_per_second\": " << ncorners / adjacency << " },\n"
+		<< "\t\t\t\"normals\": { \"time\": " << normal << ", \"corners_per_second\": " << ncorners / normal << " },\n"
+		<< "\t\t\t\"flat_packing\": { \"time\": " << flat << ", \"bytes_per_second\": " << vertexBytes / flat << " },\n"
+		<< "\t\t\t\"smooth_packing\": { \"time\": " << smooth << ", \"bytes_per_second\": " << vertexBytes / smooth << " },\n"
+		<< "\t\t\t\"compact_encoding\": { \"time\": " << encoding << ", \"bytes_per_second\": " << compactBytes / encoding << " },\n"
+		<< "\t\t\t\"meshlets\": { \"time\": " << clustering << ", \"meshlets\": " << nmeshlets
+			<< ", \"triangles_per_second\": " << ntriangles / clustering << " },\n"
+		<< "\t\t\t\"lods\": { \"time\": " << simplification << ", \"levels\": " << nlods << ", \"coarsest_triangles\": " << coarsest
+			<< ", \"triangles_per_second\": " << ntriangles / simplification << " },\n"
+		<< "\t\t\t\"peak_rss\": " << peakRSS() << "\n"
+		<< "\t\t}";
+}
+
+int main(int argc, const char* argv[]) {
+	Options opt;
+	for(int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		if(i+1 == argc) {
+			cerr << "Missing value after " << arg << endl;
+			return 1;
+		}
+		const char* value = argv[++i];
+		if(arg == "--min-facets") opt.min_facets = stoull(value);
+		else if(arg == "--max-facets") opt.max_facets = stoull(value);
+		else if(arg == "--repeat") opt.repeat = max(1, stoi(value));
+		else if(arg == "--dir") opt.dir = value;
+		else if(arg == "--filter") opt.filter = value;
+		else if(arg == "--output") opt.output = value;
+		else {
+			cerr << "Unknown option " << arg << endl;
+			return 1;
+		}
+	}
+	ofstream file;
+	if(!opt.output.empty()) file.open(opt.output);
+	ostream &json = opt.output.empty() ? cout : file;
+	json.precision(6);
+	json << "{\n"
+		<< "\t\"threads\": " << threadCount() << ",\n"
+		<< "\t\"simd\": \"" << simd::name(simd::active()) << "\",\n"
+		<< "\t\"repeat\": " << opt.repeat << ",\n"
+		<< "\t\"cases\": [\n";
+	bool first = true;
+	try {
+		fs::create_directories(opt.dir);
+		for(size_t facets = opt.min_facets; facets <= opt.max_facets; facets *= 10)
+			for(const Shape shape : { Shape::SPHERE, Shape::GRID })
+				for(const bool mixed : { false, true })
+					for(const char* format : { "obj", "ply" }) {
+						const Case c { shape, mixed, facets, format };
+						if(c.name().find(opt.filter) == string::npos) continue;
+						if(!first) json << ",\n";
+						first = false;
+						runCase(c, opt, json);
+					}
+	} catch(const exception &e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+	json << "\n\t]\n}" << endl;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "generator.h"
+
+#include <debug.h>
+#include <parallel.h>
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numbers>
+
+using namespace std;
+
+namespace {
+
+inline void addFacet(Mesh &m, const initializer_list<uint32_t> vertices) {
+	m.facet_vertices.insert(m.facet_vertices.end(), vertices);
+	m.facet_offset.push_back(m.facet_vertices.size());
+}
+
+// Add the quad abcd, split in two triangles unless `quad` is true
+inline void addQuad(Mesh &m, const uint32_t a, const uint32_t b, const uint32_t c, const uint32_t d, const bool quad) {
+	if(quad) addFacet(m, { a, b, c, d });
+	else {
+		addFacet(m, { a, b, c });
+		addFacet(m, { a, c, d });
+	}
+}
+
+// nlat bands of nlon facets (or twice as many triangles), the bands touching the poles are made of triangles
+Mesh sphere(const size_t facets, const bool mixed) {
+	const size_t nlat = max<size_t>(2, llround(sqrt(facets / (mixed ? 2. : 4.))));
+	const size_t nlon = 2 * nlat;
+	Mesh m;
+	m.points.reserve(2 + (nlat-1) * nlon);
+	m.points.emplace_back(0., 0., 1.);
+	for(size_t r = 1; r < nlat; ++r) {
+		const double theta = numbers::pi * r / nlat;
+		for(size_t j = 0; j < nlon; ++j) {
+			const double phi = 2. * numbers::pi * j / nlon;
+			m.points.emplace_back(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+		}
+	}
+	m.points.emplace_back(0., 0., -1.);
+	const uint32_t south = m.nverts() - 1;
+	const auto v = [&](const size_t r, const size_t j) { return uint32_t(1 + (r-1) * nlon + j % nlon); };
+
+	const size_t quads = (nlat - 2) * nlon;
+	m.facet_offset.reserve(1 + 2 * nlon + (mixed ? 1 : 2) * quads);
+	m.facet_vertices.reserve(6 * nlon + 4 * quads + (mixed ? 0 : 2 * quads));
+	for(size_t j = 0; j < nlon; ++j) addFacet(m, { 0, v(1, j), v(1, j+1) });
+	for(size_t r = 1; r+1 < nlat; ++r) for(size_t j = 0; j < nlon; ++j)
+		addQuad(m, v(r, j), v(r+1, j), v(r+1, j+1), v(r, j+1), mixed);
+	for(size_t j = 0; j < nlon; ++j) addFacet(m, { v(nlat-1, j), south, v(nlat-1, j+1) });
+	return m;
+}
+
+// n x n cells in the plane z = 0, in mixed mode one cell out of three is split in two triangles
+Mesh grid(const size_t facets, const bool mixed) {
+	const size_t n = max<size_t>(1, llround(sqrt(mixed ? .75 * facets : .5 * facets)));
+	Mesh m;
+	m.points.reserve((n+1) * (n+1));
+	for(size_t j = 0; j <= n; ++j) for(size_t i = 0; i <= n; ++i)
+		m.points.emplace_back(double(i) / n, double(j) / n, 0.);
+	const auto v = [&](const size_t i, const size_t j) { return uint32_t(j * (n+1) + i); };
+	m.facet_offset.reserve(1 + 2 * n * n);
+	m.facet_vertices.reserve(6 * n * n);
+	for(size_t j = 0; j < n; ++j) for(size_t i = 0; i < n; ++i)
+		addQuad(m, v(i, j), v(i+1, j), v(i+1, j+1), v(i, j+1), mixed && (i + j) % 3);
+	return m;
+}
+
+ofstream createFile(const char* filename) {
+	ofstream out(filename, ios::binary);
+	if(out.fail()) THROW_ERROR(string("Failed to create ") + filename);
+	return out;
+}
+
+void closeFile(ofstream &out, const char* filename) {
+	out.close();
+	if(out.fail()) THROW_ERROR(string("Failed to write ") + filename);
+}
+
+// Write the records [0, n) of at most `maxSize` bytes each,
+// blocks of records are formatted in parallel then written in order
+template<typename Fun>
+void writeRecords(ofstream &out, const size_t n, const size_t maxSize, const Fun &format) {
+	constexpr size_t BLOCK = 1u << 20;
+	vector<string> buffers(threadCount());
+	for(size_t b = 0; b < n; b += BLOCK) {
+		for(string &buffer : buffers) buffer.clear();
+		parallelRanges(min(n - b, BLOCK), [&](size_t t, size_t begin, size_t end) {
+			string &buffer = buffers[t];
+			buffer.resize((end - begin) * maxSize);
+			char* p = buffer.data();
+			for(size_t i = b + begin; i < b + end; ++i) p = format(i, p);
+			buffer.resize(p - buffer.data());
+		}, buffers.size());
+		for(const string &buffer : buffers) out.write(buffer.data(), buffer.size());
+	}
+}
+
+size_t maxDegree(const Mesh &m) {
+	size_t degree = 0;
+	for(size_t f = 0; f < m.nfacets(); ++f) degree = max<size_t>(degree, m.facet_offset[f+1] - m.facet_offset[f]);
+	return degree;
+}
+
+}
+
+Mesh generateMesh(const Shape shape, const size_t facets, const bool mixed) {
+	switch(shape) {
+		case Shape::SPHERE: return sphere(facets, mixed);
+		case Shape::GRID: return grid(facets, mixed);
+	}
+	return Mesh();
+}
+
+void writeOBJ(const char* filename, const Mesh &m) {
+	ofstream out = createFile(filename);
+	constexpr size_t NUMBER_SIZE = 25; // Longest shortest representation of a double
+	writeRecords(out, m.nverts(), 2 + 3 * (1 + NUMBER_SIZE), [&](const size_t i, char* p) {
+		*(p++) = 'v';
+		for(int k = 0; k < 3; ++k) {
+			*(p++) = ' ';
+			p = to_chars(p, p + NUMBER_SIZE, m.points[i][k]).ptr;
+		}
+		*(p++) = '\n';
+		return p;
+	});
+	writeRecords(out, m.nfacets(), 2 + 11 * maxDegree(m), [&](const size_t f, char* p) {
+		*(p++) = 'f';
+		for(uint32_t fc = m.facet_offset[f]; fc < m.facet_offset[f+1]; ++fc) {
+			*(p++) = ' ';
+			p = to_chars(p, p + 10, uint64_t(m.facet_vertices[fc]) + 1).ptr;
+		}
+		*(p++) = '\n';
+		return p;
+	});
+	closeFile(out, filename);
+}
+
+void writePLY(const char* filename, const Mesh &m) {
+	const size_t degree = maxDegree(m);
+	if(degree > UINT8_MAX) THROW_ERROR(string("Facets have too many corners to be written in ") + filename);
+	ofstream out = createFile(filename);
+	out << "ply\n"
+		<< "format " << (endian::native == endian::little ? "binary_little_endian" : "binary_big_endian") << " 1.0\n"
+		<< "comment generated by VisuBench\n"
+		<< "element vertex " << m.nverts() << '\n'
+		<< "property float x\nproperty float y\nproperty float z\n"
+		<< "element face " << m.nfacets() << '\n'
+		<< "property list uchar int vertex_indices\n"
+		<< "end_header\n";
+	writeRecords(out, m.nverts(), 3 * sizeof(float), [&](const size_t i, char* p) {
+		for(int k = 0; k < 3; ++k, p += sizeof(float)) {
+			const float x = m.points[i][k];
+			memcpy(p, &x, sizeof(float));
+		}
+		return p;
+	});
+	writeRecords(out, m.nfacets(), 1 + sizeof(int32_t) * degree, [&](const size_t f, char* p) {
+		const uint32_t fc0 = m.facet_offset[f], fc1 = m.facet_offset[f+1];
+		*(p++) = char(fc1 - fc0);
+		const size_t size = sizeof(int32_t) * (fc1 - fc0);
+		memcpy(p, m.facet_vertices.data() + fc0, size);
+		return p + size;
+	});
+	closeFile(out, filename);
+}
@@ -0,0 +1,17 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <geometry/mesh.h>
+
+enum class Shape { SPHERE, GRID };
+
+// Tessellated unit sphere or planar grid with about `facets` facets.
+// When `mixed` is true the mesh is made of quads and triangles, otherwise of triangles only.
+Mesh generateMesh(Shape shape, std::size_t facets, bool mixed);
+
+// Writers of the formats supported by readMesh, PLY files are binary with native endianness
+void writeOBJ(const char* filename, const Mesh &m);
+void writePLY(const char* filename, const Mesh &m);
@@ -0,0 +1,138 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+// Micro-benchmark of the geometry kernels of simd.h: corner normals, normalization and conversion of the corner points
+// run on a single thread over the corners of a generated sphere, once with the generic vec3 code they
+// replace then with every instruction set supported by the CPU.
+// Results are written as JSON on the standard output.
+//
+// Usage: VisuKernelBench [--facets N] [--repeat N]
+
+#include "../generator.h"
+
+#include <simd.h>
+#include <timer.h>
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// Smallest duration of `repeat` runs of `fun`
+double bestTime(const int repeat, const function<void()> &fun) {
+	double best = numeric_limits<double>::infinity();
+	for(int r = 0; r < repeat; ++r) {
+		Timer timer;
+		fun();
+		best = min(best, timer.elapsed());
+	}
+	return best;
+}
+
+// Code of the loader before the kernels, one corner at a time through the vec3 operators
+
+void referenceCornerNormals(const vector<vec3> &P, const vector<uint32_t> &prev, const vector<uint32_t> &cur,
+	const vector<uint32_t> &next, vector<vec3> &out) {
+	for(size_t i = 0; i < cur.size(); ++i) {
+		const vec3 a = P[prev[i]] - P[cur[i]];
+		const vec3 b = P[next[i]] - P[cur[i]];
+		const vec3 normal = cross(a, b);
+		const double s = normal.norm();
+		out[i] = (atan2(s, a * b) / s) * normal;
+	}
+}
+
+void referenceNormalize(vector<vec3> &v) {
+	for(vec3 &n : v) n.normalize();
+}
+
+void referenceConvert(const vector<vec3> &P, const vector<uint32_t> &ids, vector<vec3f> &out) {
+	for(size_t i = 0; i < ids.size(); ++i) out[i] = P[ids[i]];
+}
+
+double maxDifference(const vector<vec3> &a, const vector<vec3> &b) {
+	double d = 0.;
+	for(size_t i = 0; i < a.size(); ++i) d = max(d, (a[i] - b[i]).norm() / max(a[i].norm(), 1e-300));
+	return d;
+}
+
+void printResult(const char* isa, const size_t n, const double corners, const double normalize, const double convert,
+	const double reference[3], const double error) {
+	cout << "\t\t\"" << isa << "\": {\n"
+		<< "\t\t\t\"corner_normals\": { \"time\": " << corners << ", \"speedup\": " << reference[0] / corners << " },\n"
+		<< "\t\t\t\"normalize\": { \"time\": " << normalize << ", \"speedup\": " << reference[1] / normalize << " },\n"
+		<< "\t\t\t\"convert\": { \"time\": " << convert << ", \"speedup\": " << reference[2] / convert << " },\n"
+		<< "\t\t\t\"corners_per_second\": " << n / corners << ",\n"
+		<< "\t\t\t\"max_relative_error\": " << error << "\n"
+		<< "\t\t}";
+}
+
+}
+
+int main(int argc, const char* argv[]) {
+	size_t facets = 1'000'000;
+	int repeat = 5;
+	for(int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		if(i+1 == argc) {
+			cerr << "Missing value after " << arg << endl;
+			return 1;
+		}
+		const char* value = argv[++i];
+		if(arg == "--facets") facets = stoull(value);
+		else if(arg == "--repeat") repeat = max(1, stoi(value));
+		else {
+			cerr << "Unknown option " << arg << endl;
+			return 1;
+		}
+	}
+
+	// Corners of a sphere made of triangles and quads with their previous and next vertices
+	const Mesh m = generateMesh(Shape::SPHERE, facets, true);
+	const size_t n = m.nfacet_corners();
+	vector<uint32_t> prev(n), next(n);
+	for(uint32_t f = 0; f < m.nfacets(); ++f) for(uint32_t fc = m.facet_begin(f); fc < m.facet_end(f); ++fc) {
+		prev[fc] = m.facet_vertices[m.prev(f, fc)];
+		next[fc] = m.facet_vertices[m.next(f, fc)];
+	}
+	const vector<uint32_t> &cur = m.facet_vertices;
+
+	vector<vec3> expected(n), normals(n);
+	vector<vec3f> positions(n);
+	double reference[3];
+	reference[0] = bestTime(repeat, [&]() { referenceCornerNormals(m.points, prev, cur, next, expected); });
+	reference[1] = bestTime(repeat, [&]() { normals = expected; referenceNormalize(normals); })
+		- bestTime(repeat, [&]() { normals = expected; });
+	reference[2] = bestTime(repeat, [&]() { referenceConvert(m.points, cur, positions); });
+
+	cout.precision(6);
+	cout << "{\n"
+		<< "\t\"corners\": " << n << ",\n"
+		<< "\t\"detected\": \"" << simd::name(simd::detected()) << "\",\n"
+		<< "\t\"results\": {\n";
+	cout << "\t\t\"reference\": {\n"
+		<< "\t\t\t\"corner_normals\": { \"time\": " << reference[0] << " },\n"
+		<< "\t\t\t\"normalize\": { \"time\": " << reference[1] << " },\n"
+		<< "\t\t\t\"convert\": { \"time\": " << reference[2] << " },\n"
+		<< "\t\t\t\"corners_per_second\": " << n / reference[0] << "\n"
+		<< "\t\t}";
+	for(const simd::ISA isa : { simd::ISA::SCALAR, simd::ISA::SSE42, simd::ISA::AVX2 }) {
+		if(isa > simd::detected()) break;
+		simd::setActive(isa);
+		const double corners = bestTime(repeat, [&]() { simd::cornerNormals(m.points.data(), prev.data(), cur.data(), next.data(), n, true, normals.data()); });
+		const double error = maxDifference(expected, normals);
+		const double normalize = bestTime(repeat, [&]() { normals = expected; simd::normalize(normals.data(), n); })
+			- bestTime(repeat, [&]() { normals = expected; });
+		const double convert = bestTime(repeat, [&]() { simd::convertPoints(m.points.data(), cur.data(), n, positions.data()); });
+		cout << ",\n";
+		printResult(simd::name(isa), n, corners, normalize, convert, reference, error);
+	}
+	cout << "\n\t}\n}" << endl;
+	return 0;
+}
@@ -35,6 +35,8 @@ void load() {
 		else __config_load_int(line, "window:width", data.window_width)
 		else __config_load_int(line, "window:height", data.window_height)
 		else __config_load_int(line, "gui:style", data.style)
+		else __config_load_int(line, "mesh:precision", data.mesh_precision)
+		else __config_load_int(line, "mesh:vertex_format", data.vertex_format)
 	}
 	f.close();
 }
@@ -47,6 +49,8 @@ void save() {
 	f << "window:width=" << data.window_width << '\n';
 	f << "window:height=" << data.window_height << '\n';
 	f << "gui:style=" << data.style << '\n';
+	f << "mesh:precision=" << data.mesh_precision << '\n';
+	f << "mesh:vertex_format=" << data.vertex_format << '\n';
 	f.close();
 }
 
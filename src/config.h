@@ -11,6 +11,8 @@ struct ConfigData {
 	int window_x = 0, window_y = 0;
 	int window_width = 800, window_height = 600;
 	int style = 1;
+	int mesh_precision = 0;
+	int vertex_format = 0;
 	// TODO: Correct full screen bug
 };
 
@@ -0,0 +1,100 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "compact.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+Quantization quantization(const MeshBase &m) {
+	if(!m.nverts()) return { vec3f(0.f), vec3f(0.f) };
+	vec3 lo(numeric_limits<double>::max()), hi(numeric_limits<double>::lowest());
+	for(size_t v = 0; v < m.nverts(); ++v) {
+		const vec3 p = m.point(v);
+		for(int k = 0; k < 3; ++k) {
+			lo[k] = min(lo[k], p[k]);
+			hi[k] = max(hi[k], p[k]);
+		}
+	}
+	return { vec3f(lo), vec3f(hi - lo) };
+}
+
+// Round to nearest even, out of range values give infinities
+uint16_t toHalf(const float f) {
+	uint32_t x = bit_cast<uint32_t>(f);
+	const uint32_t sign = (x >> 16) & 0x8000u;
+	x &= 0x7fffffffu;
+	if(x >= 0x47800000u) return sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u); // NaN, infinity or overflow
+	if(x < 0x38800000u) {
+		// Subnormal: adding 0.5 makes the float rounding put the 10 bits of the result at the bottom of the mantissa
+		const float s = bit_cast<float>(x) + 0.5f;
+		return sign | uint16_t(bit_cast<uint32_t>(s) - bit_cast<uint32_t>(0.5f));
+	}
+	// Exponent rebias from 127 to 15 then rounding of the 13 dropped bits
+	x += 0xc8000fffu + ((x >> 13) & 1u);
+	return sign | uint16_t(x >> 13);
+}
+
+float fromHalf(const uint16_t h) {
+	const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+	const uint32_t e = (h >> 10) & 0x1fu, m = h & 0x3ffu;
+	if(!e) return bit_cast<float>(sign | bit_cast<uint32_t>(ldexp(float(m), -24)));
+	if(e == 31) return bit_cast<float>(sign | 0x7f800000u | (m << 13));
+	return bit_cast<float>(sign | ((e + 112u) << 23) | (m << 13));
+}
+
+void encodePositions(const vec3f* in, const size_t n, const Quantization &q, unorm16x4* out) {
+	float scale[3];
+	for(int k = 0; k < 3; ++k) scale[k] = q.extent[k] > 0.f ? float(UINT16_MAX) / q.extent[k] : 0.f;
+	for(size_t i = 0; i < n; ++i) {
+		uint16_t e[3];
+		for(int k = 0; k < 3; ++k)
+			e[k] = uint16_t(clamp((in[i][k] - q.origin[k]) * scale[k], 0.f, float(UINT16_MAX)) + 0.5f);
+		out[i] = { e[0], e[1], e[2], 0u };
+	}
+}
+
+namespace {
+
+inline float signNotZero(const float x) { return x < 0.f ? -1.f : 1.f; }
+// Round half away from zero by truncation, lrint is a library call
+inline int16_t toSnorm16(const float x) { return int16_t(clamp(x, -1.f, 1.f) * 32767.f + 0.5f * signNotZero(x)); }
+
+}
+
+// Project on the octahedron |x| + |y| + |z| = 1 then unfold its lower half on the corners of the square
+void encodeNormals(const vec3f* in, const size_t n, snorm16x2* out) {
+	for(size_t i = 0; i < n; ++i) {
+		const vec3f &v = in[i];
+		const float l1 = abs(v.x) + abs(v.y) + abs(v.z);
+		if(l1 == 0.f) {
+			out[i] = { 0, 0 };
+			continue;
+		}
+		float x = v.x / l1, y = v.y / l1;
+		if(v.z < 0.f) {
+			const float ox = x;
+			x = (1.f - abs(y)) * signNotZero(ox);
+			y = (1.f - abs(ox)) * signNotZero(y);
+		}
+		out[i] = { toSnorm16(x), toSnorm16(y) };
+	}
+}
+
+void encodeUVs(const vec2f* in, const size_t n, half2* out) {
+	for(size_t i = 0; i < n; ++i) out[i] = { toHalf(in[i].x), toHalf(in[i].y) };
+}
+
+vec3f decodeNormal(const snorm16x2 e) {
+	vec3f v(max(e.x / 32767.f, -1.f), max(e.y / 32767.f, -1.f), 0.f);
+	v.z = 1.f - abs(v.x) - abs(v.y);
+	const float t = max(-v.z, 0.f);
+	v.x += v.x >= 0.f ? -t : t;
+	v.y += v.y >= 0.f ? -t : t;
+	return v.normalize();
+}
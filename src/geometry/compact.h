@@ -0,0 +1,51 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Compact vertex values, the GPU reads them as floats through normalized or half float formats.
+// Positions are 16 bits integers relative to the bounding box (the fourth one pads to a format every GPU supports),
+// normals are octahedral coordinates in signed 16 bits and texture coordinates are half floats.
+struct unorm16x4 { std::uint16_t x, y, z, w; };
+struct snorm16x2 { std::int16_t x, y; };
+struct half2 { std::uint16_t x, y; };
+
+// Mapping of the bounding box of the points to [0, 1]^3: p = origin + extent * q / 65535
+struct Quantization {
+	vec3f origin, extent;
+};
+
+Quantization quantization(const MeshBase &m);
+
+std::uint16_t toHalf(float f);
+float fromHalf(std::uint16_t h);
+
+// Convert n values of in to their compact storage in out
+void encodePositions(const vec3f* in, std::size_t n, const Quantization &q, unorm16x4* out);
+void encodeNormals(const vec3f* in, std::size_t n, snorm16x2* out);
+void encodeUVs(const vec2f* in, std::size_t n, half2* out);
+
+// Inverse of the octahedral encoding as done by the vertex shader, a null normal gives (0, 0, 1)
+vec3f decodeNormal(snorm16x2 e);
+
+// Cell of p in a grid of 2^bits cells per axis over [0, 1]^3, numbered along a Morton curve so that close cells get
+// close numbers. p is clamped to the cube, bits is at most 10.
+inline std::uint32_t mortonCell(const vec3f &p, const unsigned bits) {
+	const auto spread = [](std::uint32_t v) {
+		v = (v | (v << 16)) & 0x030000ffu;
+		v = (v | (v << 8)) & 0x0300f00fu;
+		v = (v | (v << 4)) & 0x030c30c3u;
+		return (v | (v << 2)) & 0x09249249u;
+	};
+	const float last = float((1u << bits) - 1u);
+	std::uint32_t c[3];
+	for(int k = 0; k < 3; ++k) c[k] = std::uint32_t(std::clamp(p[k], 0.f, 1.f) * last + .5f);
+	return spread(c[0]) | (spread(c[1]) << 1) | (spread(c[2]) << 2);
+}
@@ -0,0 +1,411 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "lod.h"
+#include "compact.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// The chain stops before a level with fewer triangles, or keeping more than MAX_KEPT of the previous one
+constexpr size_t MIN_LOD_TRIANGLES = 1u << 10;
+constexpr float MAX_KEPT = .8f;
+// Weight of the planes holding borders and seams in place, relative to the areas weighting the planes of the triangles
+constexpr float FEATURE_WEIGHT = 4.f;
+// Collapses turning a triangle by more than acos(MIN_NORMAL_COS) are rejected
+constexpr float MIN_NORMAL_COS = .25f;
+// Owner of a vertex used by the triangles of several regions
+constexpr uint32_t NONE = numeric_limits<uint32_t>::max(), SHARED = NONE - 1;
+
+// Sum of weighted squared distances to planes, p^T A p + 2 b.p + c, and the sum w of the weights
+struct Quadric {
+	float a00, a01, a02, a11, a12, a22, b0, b1, b2, c, w;
+
+	Quadric& operator+=(const Quadric &q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c; w += q.w;
+		return *this;
+	}
+
+	// Mean squared distance of p to the planes
+	float error(const vec3f &p) const {
+		if(w <= 0.f) return 0.f;
+		const float x = a00 * p.x + a01 * p.y + a02 * p.z;
+		const float y = a01 * p.x + a11 * p.y + a12 * p.z;
+		const float z = a02 * p.x + a12 * p.y + a22 * p.z;
+		return max(p.x * x + p.y * y + p.z * z + 2.f * (b0 * p.x + b1 * p.y + b2 * p.z) + c, 0.f) / w;
+	}
+};
+
+// Plane of unit normal n through p, weighted by w
+Quadric planeQuadric(const vec3f &n, const vec3f &p, const float w) {
+	const float d = -(n * p);
+	return { w*n.x*n.x, w*n.x*n.y, w*n.x*n.z, w*n.y*n.y, w*n.y*n.z, w*n.z*n.z, w*n.x*d, w*n.y*d, w*n.z*d, w*d*d, w };
+}
+
+// Whether the facet corners a and b have the same attributes
+bool sameAttributes(const MeshBase &m, const uint32_t a, const uint32_t b) {
+	for(const Attribute &attribute : m.facet_corner_attributes) switch(attribute.type) {
+		case Attribute::INTEGER:
+		case Attribute::INTEGER32:
+			if(attribute.integer_at(a) != attribute.integer_at(b)) return false;
+			break;
+		case Attribute::SCALAR:
+		case Attribute::FLOAT_SCALAR:
+			if(attribute.scalar_at(a) != attribute.scalar_at(b)) return false;
+			break;
+		default: {
+			const vec2 p = attribute.vec2_at(a), q = attribute.vec2_at(b);
+			if(p.x != q.x || p.y != q.y) return false;
+		}
+	}
+	return true;
+}
+
+// Triangles of a region of the mesh, simplified by a single thread. Each triangle has three slots giving the vertex of
+// the region and the facet corner drawn at its corners, the corners of a vertex with the same attributes are merged so
+// that two slots of a vertex are on both sides of a seam when their corners differ.
+class Region {
+public:
+	// owner tells the vertices of the mesh shared with other regions, they stay in place
+	Region(const MeshBase &m, const vec3f* P, const vector<uint32_t> &owner, vector<uint32_t> &&triangles);
+
+	// Collapse edges until at most target triangles are left or none can be collapsed, returns the largest squared error
+	float simplify(size_t target);
+
+	inline size_t ntriangles() const { return slotVertices.size() / 3; }
+	// Facet corners of the triangles
+	inline const vector<uint32_t>& corners() const { return slotCorners; }
+
+private:
+	struct Collapse {
+		float cost;
+		uint32_t from, to;
+		inline bool operator<(const Collapse &c) const { return cost < c.cost; }
+	};
+
+	inline const vec3f& position(const uint32_t v) const { return P[vertices[v]]; }
+	inline uint32_t slot(const uint32_t t, const uint32_t v) const {
+		return 3*t + (slotVertices[3*t] == v ? 0 : slotVertices[3*t+1] == v ? 1 : 2);
+	}
+	inline bool contains(const uint32_t t, const uint32_t v) const {
+		return slotVertices[3*t] == v || slotVertices[3*t+1] == v || slotVertices[3*t+2] == v;
+	}
+	// Triangles around each vertex
+	void buildAdjacency();
+	// Edges from a vertex to the ones sharing a triangle with it
+	struct Edge {
+		uint32_t to, count, first; // Triangles of the edge and the first one
+		bool feature; // On a border or a seam
+	};
+	void gatherEdges(uint32_t v, vector<Edge> &res) const;
+	// Corners of `from` in wedges and the corners of `to` they become in targets. Returns false when `to` has no
+	// corner or several corners for one of them, the attributes would then be broken.
+	bool mapWedges(uint32_t from, uint32_t to);
+	// Cheapest collapse of v along the borders and seams around it, it is checked by valid once chosen
+	bool bestCollapse(uint32_t v, Collapse &res);
+	// Whether c keeps the attributes and the topology, fromEdges are the edges from c.from
+	bool valid(const Collapse &c, const vector<Edge> &fromEdges);
+	bool flips(const Collapse &c) const;
+	// Returns the number of triangles removed, edges, wedges and targets are the ones of c checked by valid
+	size_t apply(const Collapse &c, vector<uint8_t> &touched, vector<uint8_t> &removed);
+
+	const vec3f* P;
+	vector<uint32_t> vertices; // Vertices of the mesh, in order
+	vector<uint32_t> slotVertices, slotCorners;
+	vector<uint8_t> locked;
+	vector<Quadric> quadrics;
+	vector<uint32_t> aroundOffsets, around;
+	// Buffers of the searches around the vertices
+	vector<Edge> edges, toEdges;
+	vector<uint32_t> wedges, targets;
+};
+
+Region::Region(const MeshBase &m, const vec3f* P, const vector<uint32_t> &owner, vector<uint32_t> &&triangles): P(P), slotCorners(std::move(triangles)) {
+	// Triangles with a repeated vertex draw nothing
+	const uint32_t* fv = m.facet_vertices.data();
+	size_t n = 0;
+	for(size_t t = 0; 3*t < slotCorners.size(); ++t) {
+		const uint32_t a = fv[slotCorners[3*t]], b = fv[slotCorners[3*t+1]], c = fv[slotCorners[3*t+2]];
+		if(a == b || b == c || c == a) continue;
+		for(int k = 0; k < 3; ++k) slotCorners[3*n+k] = slotCorners[3*t+k];
+		++ n;
+	}
+	slotCorners.resize(3*n);
+	vertices.resize(slotCorners.size());
+	for(size_t i = 0; i < slotCorners.size(); ++i) vertices[i] = fv[slotCorners[i]];
+	sort(vertices.begin(), vertices.end());
+	vertices.erase(unique(vertices.begin(), vertices.end()), vertices.end());
+	slotVertices.resize(slotCorners.size());
+	for(size_t i = 0; i < slotCorners.size(); ++i)
+		slotVertices[i] = uint32_t(lower_bound(vertices.begin(), vertices.end(), fv[slotCorners[i]]) - vertices.begin());
+	locked.resize(vertices.size());
+	for(size_t v = 0; v < vertices.size(); ++v) locked[v] = owner[vertices[v]] == SHARED;
+	buildAdjacency();
+
+	vector<uint32_t> &merged = wedges;
+	for(uint32_t v = 0; v < vertices.size(); ++v) {
+		merged.clear();
+		for(uint32_t i = aroundOffsets[v]; i < aroundOffsets[v+1]; ++i) {
+			uint32_t &corner = slotCorners[slot(around[i], v)];
+			const auto same = find_if(merged.begin(), merged.end(), [&](const uint32_t c) { return sameAttributes(m, c, corner); });
+			if(same == merged.end()) merged.push_back(corner);
+			else corner = *same;
+		}
+	}
+
+	// Planes of the triangles weighted by their area, and planes orthogonal to them along the borders and seams
+	quadrics.assign(vertices.size(), Quadric {});
+	for(uint32_t t = 0; t < ntriangles(); ++t) {
+		const vec3f &p0 = position(slotVertices[3*t]), &p1 = position(slotVertices[3*t+1]), &p2 = position(slotVertices[3*t+2]);
+		vec3f normal = cross(p1 - p0, p2 - p0);
+		const float length = normal.norm();
+		if(length <= 0.f) continue;
+		normal /= length;
+		const Quadric q = planeQuadric(normal, p0, .5f * length);
+		for(int k = 0; k < 3; ++k) quadrics[slotVertices[3*t+k]] += q;
+
+		for(int k = 0; k < 3; ++k) {
+			const uint32_t a = slotVertices[3*t+k], b = slotVertices[3*t+(k+1)%3];
+			uint32_t opposite = NONE, count = 0;
+			for(uint32_t i = aroundOffsets[a]; i < aroundOffsets[a+1]; ++i)
+				if(around[i] != t && contains(around[i], b)) {
+					opposite = around[i];
+					++ count;
+				}
+			if(count > 1) {
+				locked[a] = locked[b] = 1;
+				continue;
+			}
+			const bool seam = count == 1 && (slotCorners[slot(opposite, a)] != slotCorners[3*t+k]
+				|| slotCorners[slot(opposite, b)] != slotCorners[3*t+(k+1)%3]);
+			if(count == 1 && !seam) continue;
+			const vec3f edge = position(b) - position(a);
+			vec3f side = cross(edge, normal);
+			const float sideLength = side.norm();
+			if(sideLength <= 0.f) continue;
+			const Quadric border = planeQuadric(side /= sideLength, position(a), FEATURE_WEIGHT * edge.norm2());
+			quadrics[a] += border;
+			quadrics[b] += border;
+		}
+	}
+}
+
+void Region::buildAdjacency() {
+	aroundOffsets.assign(vertices.size() + 1, 0u);
+	for(const uint32_t v : slotVertices) ++ aroundOffsets[v+1];
+	for(size_t v = 0; v < vertices.size(); ++v) aroundOffsets[v+1] += aroundOffsets[v];
+	around.resize(slotVertices.size());
+	vector<uint32_t> next(aroundOffsets.begin(), aroundOffsets.end() - 1);
+	for(size_t i = 0; i < slotVertices.size(); ++i) around[next[slotVertices[i]]++] = uint32_t(i / 3);
+}
+
+bool Region::mapWedges(const uint32_t from, const uint32_t to) {
+	wedges.clear();
+	for(uint32_t i = aroundOffsets[from]; i < aroundOffsets[from+1]; ++i) {
+		const uint32_t corner = slotCorners[slot(around[i], from)];
+		if(find(wedges.begin(), wedges.end(), corner) == wedges.end()) wedges.push_back(corner);
+	}
+	targets.assign(wedges.size(), NONE);
+	for(uint32_t i = aroundOffsets[from]; i < aroundOffsets[from+1]; ++i) {
+		const uint32_t t = around[i];
+		if(!contains(t, to)) continue;
+		const size_t w = find(wedges.begin(), wedges.end(), slotCorners[slot(t, from)]) - wedges.begin();
+		const uint32_t corner = slotCorners[slot(t, to)];
+		if(targets[w] != NONE && targets[w] != corner) return false;
+		targets[w] = corner;
+	}
+	return find(targets.begin(), targets.end(), NONE) == targets.end();
+}
+
+void Region::gatherEdges(const uint32_t v, vector<Edge> &res) const {
+	res.clear();
+	for(uint32_t i = aroundOffsets[v]; i < aroundOffsets[v+1]; ++i) {
+		const uint32_t t = around[i], s = slot(t, v);
+		for(const uint32_t o : { 3*t + (s+1) % 3, 3*t + (s+2) % 3 }) {
+			const uint32_t w = slotVertices[o];
+			const auto e = find_if(res.begin(), res.end(), [&](const Edge &e) { return e.to == w; });
+			if(e == res.end()) res.push_back({ w, 1u, t, false });
+			else if(++ e->count == 2) e->feature = slotCorners[s] != slotCorners[slot(e->first, v)]
+				|| slotCorners[o] != slotCorners[slot(e->first, w)];
+		}
+	}
+	for(Edge &e : res) if(e.count == 1) e.feature = true;
+}
+
+bool Region::bestCollapse(const uint32_t v, Collapse &res) {
+	// A vertex on a border or a seam only moves along it, the ends of the lines are locked
+	gatherEdges(v, edges);
+	size_t nfeatures = 0;
+	for(const Edge &e : edges) {
+		if(e.count > 2) return false;
+		nfeatures += e.feature;
+	}
+	if(nfeatures != 0 && nfeatures != 2) return false;
+
+	res.cost = numeric_limits<float>::max();
+	for(const Edge &e : edges) if(!nfeatures || e.feature) {
+		const float cost = quadrics[v].error(position(e.to));
+		if(cost < res.cost) res = { cost, v, e.to };
+	}
+	return res.cost < numeric_limits<float>::max();
+}
+
+bool Region::valid(const Collapse &c, const vector<Edge> &fromEdges) {
+	if(!mapWedges(c.from, c.to)) return false;
+	// The edge keeps the surface manifold when the only vertices next to both ends are the ones of its triangles
+	gatherEdges(c.to, toEdges);
+	uint32_t common = 0;
+	for(const Edge &e : toEdges)
+		common += find_if(fromEdges.begin(), fromEdges.end(), [&](const Edge &f) { return f.to == e.to; }) != fromEdges.end();
+	return common == find_if(fromEdges.begin(), fromEdges.end(), [&](const Edge &f) { return f.to == c.to; })->count;
+}
+
+bool Region::flips(const Collapse &c) const {
+	for(uint32_t i = aroundOffsets[c.from]; i < aroundOffsets[c.from+1]; ++i) {
+		const uint32_t t = around[i];
+		if(contains(t, c.to)) continue;
+		vec3f p[3];
+		for(int k = 0; k < 3; ++k) p[k] = position(slotVertices[3*t+k]);
+		const vec3f before = cross(p[1] - p[0], p[2] - p[0]);
+		p[slot(t, c.from) - 3*t] = position(c.to);
+		const vec3f after = cross(p[1] - p[0], p[2] - p[0]);
+		if(before * after <= MIN_NORMAL_COS * before.norm() * after.norm()) return true;
+	}
+	return false;
+}
+
+size_t Region::apply(const Collapse &c, vector<uint8_t> &touched, vector<uint8_t> &removed) {
+	size_t count = 0;
+	for(uint32_t i = aroundOffsets[c.from]; i < aroundOffsets[c.from+1]; ++i) {
+		const uint32_t t = around[i];
+		if(contains(t, c.to)) {
+			removed[t] = 1;
+			++ count;
+			continue;
+		}
+		const uint32_t s = slot(t, c.from);
+		slotVertices[s] = c.to;
+		slotCorners[s] = targets[find(wedges.begin(), wedges.end(), slotCorners[s]) - wedges.begin()];
+	}
+	quadrics[c.to] += quadrics[c.from];
+	// The triangles around these vertices changed, they wait for the next pass
+	touched[c.from] = touched[c.to] = 1;
+	for(const Edge &e : edges) touched[e.to] = 1;
+	return count;
+}
+
+float Region::simplify(const size_t target) {
+	// Passes collapse the cheapest edges whose triangles are left untouched by the cheaper ones of the pass. The best
+	// collapse of a vertex is searched again only when its triangles changed, the others are checked before collapsing.
+	float maxError = 0.f;
+	vector<Collapse> best(vertices.size()), collapses;
+	vector<uint8_t> candidate(vertices.size()), touched(vertices.size(), 1), removed;
+	while(ntriangles() > target) {
+		collapses.clear();
+		for(uint32_t v = 0; v < vertices.size(); ++v) {
+			if(touched[v]) candidate[v] = !locked[v] && bestCollapse(v, best[v]);
+			if(candidate[v]) collapses.push_back(best[v]);
+		}
+		sort(collapses.begin(), collapses.end());
+		touched.assign(vertices.size(), 0);
+		removed.assign(ntriangles(), 0);
+		size_t left = ntriangles();
+		for(const Collapse &c : collapses) {
+			if(left <= target) break;
+			if(touched[c.from] || touched[c.to]) continue;
+			gatherEdges(c.from, edges);
+			if(!valid(c, edges) || flips(c)) continue;
+			left -= apply(c, touched, removed);
+			maxError = max(maxError, c.cost);
+		}
+		if(left == ntriangles()) break;
+
+		size_t n = 0;
+		for(size_t t = 0; t < removed.size(); ++t) if(!removed[t]) {
+			for(int k = 0; k < 3; ++k) {
+				slotVertices[3*n+k] = slotVertices[3*t+k];
+				slotCorners[3*n+k] = slotCorners[3*t+k];
+			}
+			++ n;
+		}
+		slotVertices.resize(3*n);
+		slotCorners.resize(3*n);
+		buildAdjacency();
+	}
+	return maxError;
+}
+
+}
+
+vector<Lod> buildLods(const MeshBase &m, const vector<uint32_t> &indices) {
+	// Points in the unit cube, the errors are measured there then scaled back
+	const Quantization q = quantization(m);
+	const float scale = max({ q.extent.x, q.extent.y, q.extent.z, numeric_limits<float>::min() });
+	vector<vec3f> converted;
+	const vec3f* floats = m.floatPoints(converted);
+	vector<vec3f> P(m.nverts());
+	parallelRanges(P.size(), [&](size_t, const size_t begin, const size_t end) {
+		for(size_t v = begin; v < end; ++v) P[v] = (floats[v] - q.origin) / scale;
+	});
+	converted = {};
+
+	const uint32_t* fv = m.facet_vertices.data();
+	vector<Lod> res;
+	float error = 0.f;
+	while(res.size() + 1 < MAX_LODS) {
+		const vector<uint32_t> &previous = res.empty() ? indices : res.back().indices;
+		const size_t ntriangles = previous.size() / 3;
+		if(ntriangles / 2 < MIN_LOD_TRIANGLES) break;
+
+		// Regions are runs of cells along the Morton curve with about the same number of triangles
+		const size_t nregions = clamp<size_t>(ntriangles / MIN_TRIANGLES_PER_THREAD, 1, threadCount());
+		constexpr unsigned CELL_BITS = 4;
+		constexpr uint32_t NCELLS = 1u << (3*CELL_BITS);
+		vector<uint32_t> cells(ntriangles), cellOffsets(NCELLS + 1, 0u);
+		parallelRanges(ntriangles, [&](size_t, const size_t begin, const size_t end) {
+			for(size_t t = begin; t < end; ++t)
+				cells[t] = mortonCell((P[fv[previous[3*t]]] + P[fv[previous[3*t+1]]] + P[fv[previous[3*t+2]]]) / 3.f, CELL_BITS);
+		});
+		for(const uint32_t c : cells) ++ cellOffsets[c+1];
+		for(uint32_t c = 0; c < NCELLS; ++c) cellOffsets[c+1] += cellOffsets[c];
+		vector<uint32_t> cellRegions(NCELLS);
+		for(uint32_t c = 0; c < NCELLS; ++c) cellRegions[c] = uint32_t(min(nregions - 1, cellOffsets[c] * nregions / ntriangles));
+		vector<vector<uint32_t>> regionTriangles(nregions);
+		for(size_t t = 0; t < ntriangles; ++t) {
+			vector<uint32_t> &triangles = regionTriangles[cellRegions[cells[t]]];
+			triangles.insert(triangles.end(), previous.begin() + 3*t, previous.begin() + 3*t+3);
+		}
+		cells = {};
+		vector<uint32_t> owner(m.nverts(), NONE);
+		for(uint32_t r = 0; r < nregions; ++r)
+			for(const uint32_t corner : regionTriangles[r]) {
+				uint32_t &o = owner[fv[corner]];
+				o = o == NONE || o == r ? r : SHARED;
+			}
+
+		vector<float> errors(nregions, 0.f);
+		vector<vector<uint32_t>> simplified(nregions);
+		parallelRanges(nregions, [&](const size_t r, size_t, size_t) {
+			Region region(m, P.data(), owner, std::move(regionTriangles[r]));
+			errors[r] = region.simplify(region.ntriangles() / 2);
+			simplified[r] = region.corners();
+		}, nregions);
+
+		Lod lod { {}, 0.f };
+		for(const vector<uint32_t> &triangles : simplified) lod.indices.insert(lod.indices.end(), triangles.begin(), triangles.end());
+		if(lod.indices.size() / 3 > MAX_KEPT * ntriangles) break;
+		// Each level moves the surface of the previous one, the estimates of the levels add up
+		error += sqrt(*max_element(errors.begin(), errors.end())) * scale;
+		lod.error = error;
+		res.push_back(std::move(lod));
+	}
+	return res;
+}
\ No newline at end of file
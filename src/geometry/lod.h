@@ -0,0 +1,28 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+
+// Levels of the chain built for a mesh, the full resolution included
+constexpr std::size_t MAX_LODS = 8;
+
+// Simplified triangles of a mesh, given three by three by their facet corners like the ones of triangulateFacets.
+// `error` estimates the distance to the full resolution surface, in the units of the points: every level adds the root
+// of the largest mean squared distance of a collapsed vertex to the planes of its quadric. It is not a bound, parts of
+// the simplified surface may be farther.
+struct Lod {
+	std::vector<std::uint32_t> indices;
+	float error;
+};
+
+// Chain of coarser levels of the triangles `indices` of m, each one with about half the triangles of the previous one,
+// until too few triangles are left or the simplification gets stuck. The edges are collapsed greedily by increasing
+// quadric error, a vertex moving to a neighbour so that the levels reuse the corners of the mesh. Vertices on a border
+// or on a seam of facet_corner_attributes only move along it and the corners keep their attributes.
+// Each thread simplifies a region of the mesh, the vertices shared by two regions do not move within a level.
+std::vector<Lod> buildLods(const MeshBase &m, const std::vector<std::uint32_t> &indices);
\ No newline at end of file
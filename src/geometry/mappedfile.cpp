@@ -0,0 +1,65 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "mappedfile.h"
+#include "debug.h"
+
+#include <fstream>
+
+#if __has_include(<sys/mman.h>)
+	#define VISU_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+void MappedFile::open(const char* filename) {
+	close();
+
+#ifdef VISU_HAS_MMAP
+	const int fd = ::open(filename, O_RDONLY);
+	if(fd < 0) THROW_ERROR(std::string("Failed to open ") + filename);
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		int flags = MAP_PRIVATE;
+		#ifdef MAP_POPULATE
+		flags |= MAP_POPULATE; // Prefault the pages, they are all going to be read anyway
+		#endif
+		void* addr = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+		if(addr != MAP_FAILED) {
+			madvise(addr, st.st_size, MADV_SEQUENTIAL);
+			#ifdef MADV_HUGEPAGE
+			madvise(addr, st.st_size, MADV_HUGEPAGE);
+			#endif
+			ptr = (const char*) addr;
+			length = st.st_size;
+			mapped = true;
+		}
+	}
+	::close(fd);
+	if(mapped) return;
+#endif
+
+	// Buffered fallback
+	std::ifstream in(filename, std::ios::binary | std::ios::ate);
+	if(in.fail()) THROW_ERROR(std::string("Failed to open ") + filename);
+	buffer.resize(in.tellg());
+	in.seekg(0);
+	in.read(buffer.data(), buffer.size());
+	in.close();
+	ptr = buffer.data();
+	length = buffer.size();
+}
+
+void MappedFile::close() {
+#ifdef VISU_HAS_MMAP
+	if(mapped) munmap((void*) ptr, length);
+#endif
+	mapped = false;
+	ptr = nullptr;
+	length = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
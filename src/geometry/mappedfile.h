@@ -0,0 +1,36 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Read only view of a whole file.
+// The file is memory mapped when the platform allows it, otherwise it is read in a buffer.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const char* filename) { open(filename); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	void open(const char* filename);
+	void close();
+
+	inline const char* data() const { return ptr; }
+	inline std::size_t size() const { return length; }
+	inline const char* begin() const { return ptr; }
+	inline const char* end() const { return ptr + length; }
+	inline std::string_view view() const { return std::string_view(ptr, length); }
+	inline bool isMapped() const { return mapped; }
+
+private:
+	const char* ptr = nullptr;
+	std::size_t length = 0;
+	bool mapped = false;
+	std::vector<char> buffer; // Fallback storage when mmap is not available
+};
@@ -2,75 +2,426 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 // See <https://www.gnu.org/licenses/>
 
-#include "mesh.h"
+#include "readers.h"
+#include "mappedfile.h"
+#include "meshcache.h"
 #include "debug.h"
+#include "parallel.h"
+#include "timer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
 #include <cstring>
-#include <fstream>
-#include <sstream>
+#include <limits>
+#include <string_view>
+#include <type_traits>
 
 using namespace std;
 
-Mesh readOBJ(const char* filename) {
-	Mesh m;
-	vector<vec2> VT;
-	Attribute& polyline_id = m.edge_attributes.emplace_back("polyline_id", Attribute::INTEGER);
-	Attribute& tex_coords = m.facet_corner_attributes.emplace_back("tex_coords", Attribute::VEC2);
-	ifstream in(filename);
-	if(in.fail()) THROW_ERROR(string("Failed to open ") + filename);
-	string line;
-	uint32_t line_index = 0;
-	int64_t polyline_index = 0;
-	while(!in.eof()) {
-		++ line_index;
-		getline(in, line);
-		istringstream iss(line);
-		string type_token;
-		iss >> type_token;
-		if(type_token == "v") {
-			m.points.emplace_back();
-			for(ptrdiff_t i=0; i < 3; ++i) iss >> m.points.back()[i];
-		} else if(type_token == "vt") {
-			VT.emplace_back();
-			for(ptrdiff_t i=0; i < 2; ++i) iss >> VT.back()[i];
-		} else if(type_token == "f") {
-			while(true) {
-				while(!iss.eof() && !isdigit(iss.peek())) iss.get();
-				if(iss.eof()) break;
-				uint32_t tmp; iss >> tmp;
-				if(!tmp || tmp > m.points.size())
-					THROW_ERROR("Invalid vertex index at line " + to_string(line_index) + " of file '" + filename + "'");
-				m.facet_vertices.push_back(tmp - 1);
-				tex_coords.uv.emplace_back();
-				if(iss.peek() == '/') {
-					iss.get();
-					if(iss.peek() != '/') {
-						iss >> tmp;
-						if(!tmp || tmp > VT.size())
-							THROW_ERROR("Invalid texture coordinate index index at line " + to_string(line_index) + " of file '" + filename + "'");
-						tex_coords.uv.back() = VT[tmp-1];
-					}
+namespace {
+
+// Line aligned part of an OBJ file
+struct OBJChunk {
+	const char *begin, *end;
+	struct Counts {
+		size_t lines = 0, v = 0, vt = 0, f = 0, fc = 0, e = 0, l = 0;
+		inline Counts& operator+=(const Counts &o) {
+			lines += o.lines; v += o.v; vt += o.vt; f += o.f; fc += o.fc; e += o.e; l += o.l;
+			return *this;
+		}
+	};
+	// Number of elements in the chunk and number of elements in all previous chunks
+	Counts count, offset;
+};
+
+// Arrays filled by the parsing pass, allocated with their exact final size
+struct OBJOutput {
+	Mesh &m;
+	vector<vec2> &VT;
+	vector<uint32_t> &corner_vt; // 1-based texture coordinate index of each corner of the block, 0 if none
+	vector<int64_t> &polyline_id;
+	const char* filename;
+	size_t fc0; // First corner of the block
+};
+
+inline bool isBlank(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline const char* skipBlank(const char* s, const char* end) {
+	while(s < end && isBlank(*s)) ++s;
+	return s;
+}
+inline const char* skipToken(const char* s, const char* end) {
+	while(s < end && !isBlank(*s)) ++s;
+	return s;
+}
+inline const char* lineEnd(const char* s, const char* end) {
+	if(s >= end) return end;
+	const char* eol = (const char*) memchr(s, '\n', end - s);
+	return eol ? eol : end;
+}
+inline size_t countTokens(const char* s, const char* end) {
+	size_t n = 0;
+	for(s = skipBlank(s, end); s < end; s = skipBlank(skipToken(s, end), end)) ++ n;
+	return n;
+}
+
+template<typename T>
+inline const char* parseNumber(const char* s, const char* end, T &x) {
+	if(s < end && *s == '+') ++ s;
+	const auto [ptr, ec] = from_chars(s, end, x);
+	return ec == errc() ? ptr : nullptr;
+}
+
+// Convert a (possibly negative) OBJ index into a 1-based index, returns 0 if invalid
+inline uint64_t resolveIndex(const int64_t i, const size_t count) {
+	const int64_t r = i < 0 ? int64_t(count) + i + 1 : i;
+	return r < 1 || r > int64_t(count) ? 0 : r;
+}
+
+inline bool hasExtension(const string_view filename, const string_view ext) {
+	return filename.size() >= ext.size() && ranges::equal(filename.substr(filename.size() - ext.size()), ext,
+		[](const char a, const char b) { return tolower(a) == b; });
+}
+
+void countOBJChunk(OBJChunk &c) {
+	for(const char* s = c.begin; s < c.end; ++ s) {
+		const char* eol = lineEnd(s, c.end);
+		++ c.count.lines;
+		const char* t = skipBlank(s, eol);
+		const char* te = skipToken(t, eol);
+		const string_view type(t, te - t);
+		if(type == "v") ++ c.count.v;
+		else if(type == "vt") ++ c.count.vt;
+		else if(type == "f") {
+			++ c.count.f;
+			c.count.fc += countTokens(te, eol);
+		} else if(type == "l") {
+			const size_t n = countTokens(te, eol);
+			if(n) c.count.e += n - 1;
+			++ c.count.l;
+		}
+		s = eol;
+	}
+}
+
+void parseOBJChunk(const OBJChunk &c, OBJOutput &out) {
+	OBJChunk::Counts i = c.offset;
+	const auto error = [&](const char* what) {
+		THROW_ERROR(string("Invalid ") + what + " at line " + to_string(i.lines) + " of file '" + out.filename + "'");
+	};
+	for(const char* s = c.begin; s < c.end; ++ s) {
+		const char* eol = lineEnd(s, c.end);
+		++ i.lines;
+		const char* t = skipBlank(s, eol);
+		const char* te = skipToken(t, eol);
+		const string_view type(t, te - t);
+		if(type == "v") {
+			vec3 &p = out.m.points[i.v++];
+			for(ptrdiff_t k = 0; k < 3; ++k)
+				if(!(te = parseNumber(skipBlank(te, eol), eol, p[k]))) error("vertex");
+		} else if(type == "vt") {
+			vec2 &uv = out.VT[i.vt++];
+			for(ptrdiff_t k = 0; k < 2; ++k)
+				if(!(te = parseNumber(skipBlank(te, eol), eol, uv[k]))) error("texture coordinate");
+		} else if(type == "f") {
+			for(te = skipBlank(te, eol); te < eol; te = skipBlank(skipToken(te, eol), eol)) {
+				int64_t index;
+				if(!(te = parseNumber(te, eol, index))) error("vertex index");
+				const uint64_t v = resolveIndex(index, i.v);
+				if(!v) error("vertex index");
+				out.m.facet_vertices[i.fc] = v - 1;
+				out.corner_vt[i.fc - out.fc0] = 0;
+				if(te < eol && *te == '/' && ++te < eol && *te != '/') {
+					if(!(te = parseNumber(te, eol, index))) error("texture coordinate index");
+					const uint64_t vt = resolveIndex(index, i.vt);
+					if(!vt) error("texture coordinate index");
+					out.corner_vt[i.fc - out.fc0] = vt;
 				}
+				++ i.fc;
 			}
-			m.facet_offset.push_back(m.facet_vertices.size());
-		} else if(type_token == "l") {
-			int i, j;
-			for(iss >> i; iss >> j; i = j) {
-				m.edge_vertices.push_back(i);
-				m.edge_vertices.push_back(j);
-				polyline_id.iu.push_back(polyline_index);
+			out.m.facet_offset[++i.f] = i.fc;
+		} else if(type == "l") {
+			int64_t prev = -1;
+			for(te = skipBlank(te, eol); te < eol; te = skipBlank(skipToken(te, eol), eol)) {
+				int64_t index;
+				if(!(te = parseNumber(te, eol, index))) error("polyline vertex index");
+				const uint64_t v = resolveIndex(index, i.v);
+				if(!v) error("polyline vertex index");
+				if(prev >= 0) {
+					out.m.edge_vertices[2*i.e] = prev;
+					out.m.edge_vertices[2*i.e+1] = v - 1;
+					out.polyline_id[i.e++] = i.l;
+				}
+				prev = v - 1;
+			}
+			++ i.l;
+		}
+		s = eol;
+	}
+}
+
+// Parse an OBJ file block after block, each block being appended to the mesh
+class OBJReader {
+public:
+	OBJReader(const char* filename, Mesh &m): m(m), filename(filename) {
+		m.edge_attributes.emplace_back("polyline_id", Attribute::INTEGER);
+		m.facet_corner_attributes.emplace_back("tex_coords", Attribute::VEC2);
+	}
+
+	// Parse the line aligned block [begin, end)
+	void parse(const char* begin, const char* end) {
+		// Split the block in line aligned chunks, one per thread and at least 1MB each
+		const size_t size = end - begin;
+		vector<OBJChunk> chunks(clamp<size_t>(size >> 20, 1, threadCount()));
+		for(size_t i = 0, n = chunks.size(); i < n; ++i) {
+			chunks[i].begin = i ? chunks[i-1].end : begin;
+			const char* s = i+1 == n ? end : max<const char*>(chunks[i].begin, begin + (i+1) * size / n);
+			const char* eol = lineEnd(s, end);
+			chunks[i].end = eol == end ? end : eol + 1;
+		}
+
+		// Counting pass then prefix sums to know where each chunk writes
+		parallelFor(chunks.size(), [&](size_t i) { countOBJChunk(chunks[i]); });
+		const OBJChunk::Counts start = total;
+		for(OBJChunk &c : chunks) {
+			c.offset = total;
+			total += c.count;
+		}
+
+		Attribute& polyline_id = m.edge_attributes[0];
+		Attribute& tex_coords = m.facet_corner_attributes[0];
+		VT.resize(total.vt);
+		corner_vt.resize(total.fc - start.fc);
+		m.points.resize(total.v);
+		m.facet_vertices.resize(total.fc);
+		m.facet_offset.resize(total.f + 1);
+		m.edge_vertices.resize(2 * total.e);
+		polyline_id.iu.resize(total.e);
+
+		// Parsing pass
+		OBJOutput out { m, VT, corner_vt, polyline_id.iu, filename, start.fc };
+		parallelFor(chunks.size(), [&](size_t i) { parseOBJChunk(chunks[i], out); });
+
+		// Texture coordinates can reference values parsed by previous chunks so they are resolved at the end
+		if(!VT.empty()) {
+			tex_coords.uv.resize(total.fc);
+			parallelRanges(total.fc - start.fc, [&](size_t, size_t b, size_t e) {
+				for(size_t i = b; i < e; ++i)
+					tex_coords.uv[start.fc + i] = corner_vt[i] ? VT[corner_vt[i]-1] : vec2(0., 0.);
+			});
+		}
+	}
+
+	void finish() {
+		if(VT.empty()) m.facet_corner_attributes.clear();
+		if(m.edge_vertices.empty()) m.edge_attributes.clear();
+	}
+
+private:
+	Mesh &m;
+	const char* filename;
+	OBJChunk::Counts total;
+	vector<vec2> VT;
+	vector<uint32_t> corner_vt;
+};
+
+}
+
+Mesh readOBJ(const char* filename) {
+	Timer timer;
+	const MappedFile data(filename);
+	Mesh m;
+	OBJReader reader(filename, m);
+	reader.parse(data.begin(), data.end());
+	reader.finish();
+	// Debug report, VisuBench measures the read throughput of release builds
+	[[maybe_unused]] const double time = timer.elapsed();
+	PRINT_INFO("OBJ", filename, "read in", time, "s:",
+				data.size() / (1e6 * time), "MB/s,", m.nfacets() / time, "facets/s");
+	return m;
+}
+
+// Parse blocks of growing size so that the first facets are available quickly
+static void streamOBJ(const char* filename, Mesh &m, const function<void(const Mesh&, size_t)> &onFacets) {
+	const MappedFile data(filename);
+	OBJReader reader(filename, m);
+	size_t blockSize = 1u << 20;
+	for(const char* begin = data.begin(); begin < data.end(); blockSize = min<size_t>(2 * blockSize, 64u << 20)) {
+		const char* end = data.end() - begin <= ptrdiff_t(blockSize) ? data.end() : lineEnd(begin + blockSize, data.end());
+		if(end < data.end()) ++ end;
+		const size_t first = m.nfacets();
+		reader.parse(begin, end);
+		if(m.nfacets() > first) onFacets(m, first);
+		begin = end;
+	}
+	reader.finish();
+}
+
+size_t Attribute::size() const {
+	switch(type) {
+		case INTEGER: return iu.size();
+		case SCALAR: return u.size();
+		case VEC2: return uv.size();
+		case INTEGER32: return iu32.size();
+		case FLOAT_SCALAR: return uf.size();
+		case FLOAT_VEC2: return uvf.size();
+	}
+	return 0;
+}
+
+namespace {
+
+// Storage of the values of type T in an attribute
+template<typename T>
+vector<T>& values(Attribute &a) {
+	if constexpr (is_same_v<T, int64_t>) return a.iu;
+	else if constexpr (is_same_v<T, double>) return a.u;
+	else if constexpr (is_same_v<T, vec2>) return a.uv;
+	else if constexpr (is_same_v<T, int32_t>) return a.iu32;
+	else if constexpr (is_same_v<T, float>) return a.uf;
+	else return a.uvf;
+}
+
+// Replace the values of `a` by `v`, of type `type`
+template<typename T>
+void replaceValues(Attribute &a, vector<T> &&v, const Attribute::TYPE type) {
+	Attribute res(a.name, type);
+	values<T>(res) = std::move(v);
+	a.~Attribute();
+	new(&a) Attribute(std::move(res));
+}
+
+template<typename To, typename From>
+vector<To> convert(const vector<From> &values) {
+	vector<To> res(values.size());
+	parallelRanges(values.size(), [&](size_t, size_t begin, size_t end) {
+		for(size_t i = begin; i < end; ++i) res[i] = To(values[i]);
+	});
+	return res;
+}
+
+}
+
+void Attribute::setPrecision(const Precision precision) {
+	if(precision == Precision::DOUBLE) {
+		switch(type) {
+			case INTEGER32: replaceValues(*this, convert<int64_t>(iu32), INTEGER); break;
+			case FLOAT_SCALAR: replaceValues(*this, convert<double>(uf), SCALAR); break;
+			case FLOAT_VEC2: replaceValues(*this, convert<vec2>(uvf), VEC2); break;
+			default: break;
+		}
+	} else {
+		switch(type) {
+			case INTEGER:
+				if(ranges::all_of(iu, [](const int64_t x) { return x >= INT32_MIN && x <= INT32_MAX; }))
+					replaceValues(*this, convert<int32_t>(iu), INTEGER32);
+				break;
+			case SCALAR: replaceValues(*this, convert<float>(u), FLOAT_SCALAR); break;
+			case VEC2: replaceValues(*this, convert<vec2f>(uv), FLOAT_VEC2); break;
+			default: break;
+		}
+	}
+}
+
+void MeshBase::setPrecision(const Precision precision) {
+	if(precision != storage) {
+		// Go through double precision
+		if(storage != Precision::DOUBLE) {
+			points.resize(nverts());
+			parallelFor(points.size(), [&](size_t v) { points[v] = point(v); });
+			points_f = {};
+			points_q = {};
+			storage = Precision::DOUBLE;
+		}
+		if(precision == Precision::FLOAT) {
+			points_f = convert<vec3f>(points);
+		} else if(precision == Precision::QUANTIZED16) {
+			vec3 lo(numeric_limits<double>::max()), hi(numeric_limits<double>::lowest());
+			for(const vec3 &p : points) for(int k = 0; k < 3; ++k) {
+				lo[k] = min(lo[k], p[k]);
+				hi[k] = max(hi[k], p[k]);
 			}
-			++ polyline_index;
+			q_origin = lo;
+			for(int k = 0; k < 3; ++k) q_scale[k] = hi[k] > lo[k] ? (hi[k] - lo[k]) / UINT16_MAX : 1.;
+			points_q.resize(points.size());
+			parallelFor(points.size(), [&](size_t v) {
+				for(int k = 0; k < 3; ++k) points_q[v][k] = uint16_t(lround((points[v][k] - q_origin[k]) / q_scale[k]));
+			});
 		}
+		if(precision != Precision::DOUBLE) points = {};
+		storage = precision;
+	}
+	for(vector<Attribute>* attributes : { &point_attributes, &edge_attributes, &facet_attributes, &facet_corner_attributes })
+		for(Attribute &a : *attributes) a.setPrecision(precision);
+}
+
+const vec3* MeshBase::doublePoints(uint32_t* ids, const size_t n, vec3* buffer, const uint32_t first) const {
+	if(storage == Precision::DOUBLE) return points.data();
+	for(size_t i = 0; i < n; ++i) {
+		buffer[first + i] = point(ids[i]);
+		ids[i] = first + uint32_t(i);
+	}
+	return buffer;
+}
+
+const vec3f* MeshBase::floatPoints(vector<vec3f> &buffer) const {
+	if(storage == Precision::FLOAT) return points_f.data();
+	buffer.resize(nverts());
+	parallelFor(buffer.size(), [&](size_t v) { buffer[v] = point(v); });
+	return buffer.data();
+}
+
+namespace {
+
+template<uint32_t N>
+MeshT<N> withArity(Mesh &&m) {
+	MeshT<N> res;
+	static_cast<MeshBase&>(res) = std::move(static_cast<MeshBase&>(m));
+	m = Mesh();
+	return res;
+}
+
+}
+
+AnyMesh specializeMesh(Mesh &&m) {
+	if(!m.nfacets()) return std::move(m);
+	const uint32_t n = m.facet_offset[1];
+	atomic<bool> uniform = true;
+	parallelRanges(m.nfacets(), [&](size_t, size_t begin, size_t end) {
+		for(size_t f = begin; f < end && uniform; ++f)
+			if(m.facet_offset[f+1] - m.facet_offset[f] != n) uniform = false;
+	});
+	if(uniform && n == 3) return withArity<3>(std::move(m));
+	if(uniform && n == 4) return withArity<4>(std::move(m));
+	return std::move(m);
+}
+
+Mesh readMesh(const char* filename, const bool useCache) {
+	Timer timer;
+	Mesh m;
+	if(useCache && readMeshCache(filename, m)) {
+		PRINT_INFO("Mesh", filename, "loaded from cache in", timer.elapsed(), "s");
+		return m;
 	}
-	in.close();
-	if(VT.empty()) m.facet_corner_attributes.clear();
-	if(m.edge_vertices.empty()) m.edge_attributes.clear();
+	if(hasExtension(filename, ".obj")) m = readOBJ(filename);
+	else if(hasExtension(filename, ".ply")) m = readPLY(filename);
+	else if(hasExtension(filename, ".stl")) m = readSTL(filename);
+	else THROW_ERROR(string("mesh filename extension not recognized: ") + filename);
+	// Only slow parses are worth a cache file
+	if(useCache && timer.elapsed() > MESH_CACHE_MIN_PARSE_TIME) writeMeshCache(filename, m);
 	return m;
 }
 
-Mesh readMesh(const char* filename) {
-	size_t filename_len = strlen(filename);
-	if(!strcmp(filename+filename_len-4, ".obj")) return readOBJ(filename);
-	THROW_ERROR(string("mesh filename extension not recognized: ") + filename);
-}
\ No newline at end of file
+void streamMesh(const char* filename, Mesh &m, const function<void(const Mesh&, size_t)> &onFacets) {
+	Timer timer;
+	if(readMeshCache(filename, m)) {
+		PRINT_INFO("Mesh", filename, "loaded from cache in", timer.elapsed(), "s");
+	} else if(hasExtension(filename, ".obj")) {
+		streamOBJ(filename, m, onFacets);
+		PRINT_INFO("OBJ", filename, "streamed in", timer.elapsed(), "s");
+		if(timer.elapsed() > MESH_CACHE_MIN_PARSE_TIME) writeMeshCache(filename, m);
+		return;
+	} else m = readMesh(filename);
+	if(m.nfacets()) onFacets(m, 0);
+}
@@ -6,22 +6,39 @@
 
 #include <maths.h>
 
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <variant>
 #include <vector>
 
+// Storage of the mesh values, readers produce double precision meshes
+enum class Precision : std::uint32_t {
+	DOUBLE,
+	FLOAT,
+	QUANTIZED16 // Points are 16 bits integers relative to the bounding box, attributes are in single precision
+};
+
 class Attribute {
 public:
 	std::string name;
 	enum TYPE {
 		INTEGER,
 		SCALAR,
-		VEC2
+		VEC2,
+		// Compact storages
+		INTEGER32,
+		FLOAT_SCALAR,
+		FLOAT_VEC2
 	} type;
 	union {
 		std::vector<int64_t> iu;
 		std::vector<double> u;
 		std::vector<vec2> uv;
+		std::vector<int32_t> iu32;
+		std::vector<float> uf;
+		std::vector<vec2f> uvf;
 	};
 
 	Attribute(const std::string &name, TYPE type): name(name), type(type) {
@@ -29,6 +46,9 @@ public:
 			case INTEGER: new(&iu) decltype(iu)(); break;
 			case SCALAR: new(&u) decltype(u)(); break;
 			case VEC2: new(&uv) decltype(uv)(); break;
+			case INTEGER32: new(&iu32) decltype(iu32)(); break;
+			case FLOAT_SCALAR: new(&uf) decltype(uf)(); break;
+			case FLOAT_VEC2: new(&uvf) decltype(uvf)(); break;
 		}
 	}
 
@@ -37,26 +57,47 @@ public:
 			case INTEGER: new(&iu) decltype(iu)(std::move(a.iu)); break;
 			case SCALAR: new(&u) decltype(u)(std::move(a.u)); break;
 			case VEC2: new(&uv) decltype(uv)(std::move(a.uv)); break;
+			case INTEGER32: new(&iu32) decltype(iu32)(std::move(a.iu32)); break;
+			case FLOAT_SCALAR: new(&uf) decltype(uf)(std::move(a.uf)); break;
+			case FLOAT_VEC2: new(&uvf) decltype(uvf)(std::move(a.uvf)); break;
 		}
 	}
 
-	~Attribute() {
+	~Attribute() { destroy(); }
+
+	// Values whatever the storage
+	inline std::int64_t integer_at(const std::size_t i) const { return type == INTEGER32 ? iu32[i] : iu[i]; }
+	inline double scalar_at(const std::size_t i) const { return type == FLOAT_SCALAR ? uf[i] : u[i]; }
+	inline vec2 vec2_at(const std::size_t i) const { return type == FLOAT_VEC2 ? vec2(uvf[i]) : uv[i]; }
+	std::size_t size() const;
+
+	// Use single precision storage unless `precision` is DOUBLE, integers are narrowed only when they fit in 32 bits
+	void setPrecision(Precision precision);
+
+private:
+	void destroy() {
 		switch(type) {
 			case INTEGER: iu.~vector(); break;
 			case SCALAR: u.~vector(); break;
 			case VEC2: uv.~vector(); break;
+			case INTEGER32: iu32.~vector(); break;
+			case FLOAT_SCALAR: uf.~vector(); break;
+			case FLOAT_VEC2: uvf.~vector(); break;
 		}
 	}
 };
 
-class Mesh {
+// Geometry, topology and attributes shared by every mesh type
+class MeshBase {
 public:
 	// GEOMETRY
+	// Readers fill `points`, which is emptied when setPrecision chooses a compact storage.
+	// point(v) gives the points whatever the storage.
 	std::vector<vec3> points;
 
 	// TOPOLOGY
 	std::vector<std::uint32_t> edge_vertices;
-	std::vector<std::uint32_t> facet_vertices, facet_offset;
+	std::vector<std::uint32_t> facet_vertices;
 
 	// ATTRIBUTES
 	std::vector<Attribute>
@@ -64,13 +105,91 @@ public:
 		edge_attributes,
 		facet_attributes,
 		facet_corner_attributes;
-	
-	Mesh(): facet_offset(1, 0u) {}
 
-	inline std::size_t nverts() const { return points.size(); }
-	inline std::size_t nfacets() const { return facet_offset.size()-1; }
+	inline std::size_t nverts() const {
+		switch(storage) {
+			case Precision::FLOAT: return points_f.size();
+			case Precision::QUANTIZED16: return points_q.size();
+			default: return points.size();
+		}
+	}
 	inline std::size_t nfacet_corners() const { return facet_vertices.size(); }
 
+	inline vec3 point(const std::size_t v) const {
+		switch(storage) {
+			case Precision::FLOAT: return points_f[v];
+			case Precision::QUANTIZED16: {
+				const std::array<std::uint16_t, 3> &q = points_q[v];
+				return vec3(q_origin.x + q_scale.x * q[0], q_origin.y + q_scale.y * q[1], q_origin.z + q_scale.z * q[2]);
+			}
+			default: return points[v];
+		}
+	}
+	inline vec3 corner_point(const std::uint32_t fc) const { return point(facet_vertices[fc]); }
+	// Points of the n vertices ids[i] in double precision, as read by the kernels of simd.h. Points stored in DOUBLE are
+	// read in place. The others are decoded in buffer[first, first + n) and ids[i] becomes first + i to index them, so
+	// that only the points of a chunk are decoded.
+	const vec3* doublePoints(std::uint32_t* ids, std::size_t n, vec3* buffer, std::uint32_t first = 0u) const;
+	// All the points in single precision, they are converted in `buffer` when the storage is not FLOAT
+	const vec3f* floatPoints(std::vector<vec3f> &buffer) const;
+
+	inline Precision precision() const { return storage; }
+	// Move points and attributes in the storage `precision`, going back to DOUBLE does not restore the lost digits
+	void setPrecision(Precision precision);
+
+protected:
+	Precision storage = Precision::DOUBLE;
+	std::vector<vec3f> points_f;
+	std::vector<std::array<std::uint16_t, 3>> points_q;
+	vec3 q_origin, q_scale; // Quantized point q is q_origin + q_scale * q
+
+	inline vec3 corner_normal(const std::uint32_t pfc, const std::uint32_t fc, const std::uint32_t nfc) const {
+		const vec3 a = corner_point(pfc) - corner_point(fc);
+		const vec3 b = corner_point(nfc) - corner_point(fc);
+		// Degenerate corners keep a null normal
+		const vec3 n = cross(a, b);
+		const double length = n.norm();
+		return length > 0. ? n / length : n;
+	}
+};
+
+// Mesh whose facets all have N corners, the corners of facet f are [N*f, N*(f+1)).
+// There is no facet_offset and prev/next are branch free.
+template<std::uint32_t N>
+class MeshT : public MeshBase {
+public:
+	constexpr static std::uint32_t ARITY = N;
+
+	inline std::size_t nfacets() const { return facet_vertices.size() / N; }
+	inline std::uint32_t facet_begin(const std::uint32_t f) const { return N * f; }
+	inline std::uint32_t facet_end(const std::uint32_t f) const { return N * (f+1); }
+
+	inline std::uint32_t prev(const std::uint32_t f, const std::uint32_t fc) const {
+		return N * f + (fc - N * f + N - 1) % N;
+	}
+	inline std::uint32_t next(const std::uint32_t f, const std::uint32_t fc) const {
+		return N * f + (fc - N * f + 1) % N;
+	}
+
+	inline vec3 corner_normal(const std::uint32_t f, const std::uint32_t fc) const {
+		return MeshBase::corner_normal(prev(f, fc), fc, next(f, fc));
+	}
+};
+
+// Polygons of any size, the corners of facet f are [facet_offset[f], facet_offset[f+1])
+template<>
+class MeshT<0> : public MeshBase {
+public:
+	constexpr static std::uint32_t ARITY = 0;
+
+	std::vector<std::uint32_t> facet_offset;
+
+	MeshT(): facet_offset(1, 0u) {}
+
+	inline std::size_t nfacets() const { return facet_offset.size()-1; }
+	inline std::uint32_t facet_begin(const std::uint32_t f) const { return facet_offset[f]; }
+	inline std::uint32_t facet_end(const std::uint32_t f) const { return facet_offset[f+1]; }
+
 	inline std::uint32_t prev(const std::uint32_t f, const std::uint32_t fc) const {
 		return fc == facet_offset[f] ? facet_offset[f+1]-1 : fc-1;
 	}
@@ -78,14 +197,22 @@ public:
 		return fc+1 == facet_offset[f+1] ? facet_offset[f] : fc+1;
 	}
 
-	inline const vec3& corner_point(const std::uint32_t fc) const { return points[facet_vertices[fc]]; }
-	vec3 corner_normal(const std::uint32_t f, const std::uint32_t fc) const {
-		const std::uint32_t pfc = prev(f, fc);
-		const std::uint32_t nfc = next(f, fc);
-		const vec3 a = points[facet_vertices[pfc]] - points[facet_vertices[fc]];
-		const vec3 b = points[facet_vertices[nfc]] - points[facet_vertices[fc]];
-		return cross(a, b).normalize();
+	inline vec3 corner_normal(const std::uint32_t f, const std::uint32_t fc) const {
+		return MeshBase::corner_normal(prev(f, fc), fc, next(f, fc));
 	}
 };
 
-Mesh readMesh(const char* filename);
\ No newline at end of file
+using Mesh = MeshT<0>;
+using TriMesh = MeshT<3>;
+using QuadMesh = MeshT<4>;
+// Mesh stored with the most specialized type for its facets
+using AnyMesh = std::variant<TriMesh, QuadMesh, Mesh>;
+
+// Move `m` in a fixed arity mesh when all its facets are triangles or all are quads
+AnyMesh specializeMesh(Mesh &&m);
+
+// Read a mesh file, going through the binary cache of meshcache.h when `useCache` is true
+Mesh readMesh(const char* filename, bool useCache = true);
+// Read a mesh progressively: `onFacets(m, first)` is called each time the facets [first, m.nfacets()) become available.
+// OBJ files are parsed block after block, other formats are read at once.
+void streamMesh(const char* filename, Mesh &m, const std::function<void(const Mesh&, std::size_t)> &onFacets);
\ No newline at end of file
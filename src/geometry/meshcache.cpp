@@ -0,0 +1,242 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "meshcache.h"
+#include "mappedfile.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <thread>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char MAGIC[8] = "VISUMSH";
+constexpr uint32_t ENDIANNESS = 0x01020304u;
+
+struct SourceKey {
+	string path;
+	uint64_t size;
+	int64_t mtime;
+};
+
+bool getSourceKey(const char* filename, SourceKey &key) {
+	error_code ec;
+	key.path = fs::absolute(filename, ec).lexically_normal().string();
+	if(ec) return false;
+	key.size = fs::file_size(filename, ec);
+	if(ec) return false;
+	key.mtime = fs::last_write_time(filename, ec).time_since_epoch().count();
+	return !ec;
+}
+
+inline uint64_t alignOffset(const uint64_t offset) {
+	return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+template<typename T>
+bool readArray(vector<T> &v, const char* data, const uint64_t size) {
+	if(size % sizeof(T)) return false;
+	v.resize(size / sizeof(T));
+	// Empty vectors may have no storage
+	if(size) memcpy((void*) v.data(), data, size);
+	return true;
+}
+
+bool readAttribute(vector<Attribute> &attributes, const MeshCacheSection &s, const char* data) {
+	if(s.attribute_type > Attribute::FLOAT_VEC2) return false;
+	Attribute &a = attributes.emplace_back(string(s.name, strnlen(s.name, sizeof(s.name))), Attribute::TYPE(s.attribute_type));
+	switch(a.type) {
+		case Attribute::INTEGER: return readArray(a.iu, data, s.size);
+		case Attribute::SCALAR: return readArray(a.u, data, s.size);
+		case Attribute::VEC2: return readArray(a.uv, data, s.size);
+		case Attribute::INTEGER32: return readArray(a.iu32, data, s.size);
+		case Attribute::FLOAT_SCALAR: return readArray(a.uf, data, s.size);
+		case Attribute::FLOAT_VEC2: return readArray(a.uvf, data, s.size);
+	}
+	return false;
+}
+
+// Whether the arrays of m are consistent, like the readers check the indices they parse. A corrupt cache would
+// otherwise lead to reads out of bounds in the triangulation, the normals or the levels of detail.
+bool isConsistent(const Mesh &m) {
+	const size_t nverts = m.points.size(), ncorners = m.facet_vertices.size();
+	if(m.facet_offset.empty() || m.facet_offset.front() != 0u || m.facet_offset.back() != ncorners
+		|| adjacent_find(m.facet_offset.begin(), m.facet_offset.end(), greater<uint32_t>()) != m.facet_offset.end()) return false;
+	if(m.edge_vertices.size() % 2) return false;
+	const auto inPoints = [&](const uint32_t v) { return v < nverts; };
+	if(!all_of(m.facet_vertices.begin(), m.facet_vertices.end(), inPoints)
+		|| !all_of(m.edge_vertices.begin(), m.edge_vertices.end(), inPoints)) return false;
+	// Attributes have a value per element
+	const auto sized = [](const vector<Attribute> &attributes, const size_t n) {
+		return all_of(attributes.begin(), attributes.end(), [&](const Attribute &a) { return a.size() == n; });
+	};
+	return sized(m.point_attributes, nverts) && sized(m.edge_attributes, m.edge_vertices.size() / 2)
+		&& sized(m.facet_attributes, m.facet_offset.size() - 1) && sized(m.facet_corner_attributes, ncorners);
+}
+
+}
+
+string meshCachePath(const char* filename) {
+	error_code ec;
+	const string path = fs::absolute(filename, ec).lexically_normal().string();
+	// FNV-1a hash of the absolute path
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for(const char c : path) hash = (hash ^ (unsigned char) c) * 0x100000001b3ull;
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.vmc", (unsigned long long) hash);
+	return string(BUILD_DIR "/cache/") + name;
+}
+
+bool readMeshCache(const char* filename, Mesh &m) {
+	SourceKey key;
+	if(!getSourceKey(filename, key)) return false;
+	const string cachePath = meshCachePath(filename);
+	error_code ec;
+	if(!fs::exists(cachePath, ec)) return false;
+	MappedFile file;
+	try { file.open(cachePath.c_str()); }
+	catch(const AppError &) { return false; }
+
+	// Check the header
+	if(file.size() < sizeof(MeshCacheHeader)) return false;
+	MeshCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if(memcmp(header.magic, MAGIC, sizeof(MAGIC))
+		|| header.version != MESH_CACHE_VERSION
+		|| header.endianness != ENDIANNESS
+		|| header.source_size != key.size
+		|| header.source_mtime != key.mtime) return false;
+	if(sizeof(header) + header.section_count * sizeof(MeshCacheSection) > file.size()) return false;
+	const MeshCacheSection* sections = reinterpret_cast<const MeshCacheSection*>(file.data() + sizeof(header));
+
+	// Read sections
+	Mesh res;
+	bool samePath = false;
+	for(uint32_t i = 0; i < header.section_count; ++i) {
+		const MeshCacheSection &s = sections[i];
+		if(s.offset > file.size() || s.size > file.size() - s.offset) return false;
+		const char* data = file.data() + s.offset;
+		bool ok = true;
+		switch(s.kind) {
+			case MeshCacheSection::SOURCE_PATH: samePath = string_view(data, s.size) == key.path; break;
+			case MeshCacheSection::POINTS: ok = readArray(res.points, data, s.size); break;
+			case MeshCacheSection::EDGE_VERTICES: ok = readArray(res.edge_vertices, data, s.size); break;
+			case MeshCacheSection::FACET_VERTICES: ok = readArray(res.facet_vertices, data, s.size); break;
+			case MeshCacheSection::FACET_OFFSET: ok = readArray(res.facet_offset, data, s.size); break;
+			case MeshCacheSection::POINT_ATTRIBUTE: ok = readAttribute(res.point_attributes, s, data); break;
+			case MeshCacheSection::EDGE_ATTRIBUTE: ok = readAttribute(res.edge_attributes, s, data); break;
+			case MeshCacheSection::FACET_ATTRIBUTE: ok = readAttribute(res.facet_attributes, s, data); break;
+			case MeshCacheSection::FACET_CORNER_ATTRIBUTE: ok = readAttribute(res.facet_corner_attributes, s, data); break;
+			default: ok = false;
+		}
+		if(!ok) return false;
+	}
+	if(!samePath || !isConsistent(res)) return false;
+	m = std::move(res);
+	return true;
+}
+
+void writeMeshCache(const char* filename, const Mesh &m) {
+	// The cache stores what readers produce
+	if(m.precision() != Precision::DOUBLE) return;
+	SourceKey key;
+	if(!getSourceKey(filename, key)) return;
+
+	// Sections list
+	vector<MeshCacheSection> sections;
+	vector<const void*> data;
+	const auto add = [&](MeshCacheSection::KIND kind, const void* ptr, uint64_t size) -> MeshCacheSection& {
+		data.push_back(ptr);
+		MeshCacheSection &s = sections.emplace_back();
+		memset(&s, 0, sizeof(s));
+		s.kind = kind;
+		s.size = size;
+		return s;
+	};
+	const auto addAttributes = [&](MeshCacheSection::KIND kind, const vector<Attribute> &attributes) {
+		for(const Attribute &a : attributes) {
+			if(a.name.size() >= sizeof(MeshCacheSection::name)) {
+				DEBUG_MSG("WARNING: attribute name too long to be cached:", a.name);
+				return false;
+			}
+			MeshCacheSection *s = nullptr;
+			switch(a.type) {
+				case Attribute::INTEGER: s = &add(kind, a.iu.data(), a.iu.size() * sizeof(int64_t)); break;
+				case Attribute::SCALAR: s = &add(kind, a.u.data(), a.u.size() * sizeof(double)); break;
+				case Attribute::VEC2: s = &add(kind, a.uv.data(), a.uv.size() * sizeof(vec2)); break;
+				case Attribute::INTEGER32: s = &add(kind, a.iu32.data(), a.iu32.size() * sizeof(int32_t)); break;
+				case Attribute::FLOAT_SCALAR: s = &add(kind, a.uf.data(), a.uf.size() * sizeof(float)); break;
+				case Attribute::FLOAT_VEC2: s = &add(kind, a.uvf.data(), a.uvf.size() * sizeof(vec2f)); break;
+			}
+			s->attribute_type = a.type;
+			memcpy(s->name, a.name.data(), a.name.size());
+		}
+		return true;
+	};
+	add(MeshCacheSection::SOURCE_PATH, key.path.data(), key.path.size());
+	add(MeshCacheSection::POINTS, m.points.data(), m.points.size() * sizeof(vec3));
+	add(MeshCacheSection::EDGE_VERTICES, m.edge_vertices.data(), m.edge_vertices.size() * sizeof(uint32_t));
+	add(MeshCacheSection::FACET_VERTICES, m.facet_vertices.data(), m.facet_vertices.size() * sizeof(uint32_t));
+	add(MeshCacheSection::FACET_OFFSET, m.facet_offset.data(), m.facet_offset.size() * sizeof(uint32_t));
+	if(!addAttributes(MeshCacheSection::POINT_ATTRIBUTE, m.point_attributes)
+		|| !addAttributes(MeshCacheSection::EDGE_ATTRIBUTE, m.edge_attributes)
+		|| !addAttributes(MeshCacheSection::FACET_ATTRIBUTE, m.facet_attributes)
+		|| !addAttributes(MeshCacheSection::FACET_CORNER_ATTRIBUTE, m.facet_corner_attributes)) return;
+
+	// Layout
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.endianness = ENDIANNESS;
+	header.source_size = key.size;
+	header.source_mtime = key.mtime;
+	header.section_count = sections.size();
+	uint64_t offset = sizeof(header) + sections.size() * sizeof(MeshCacheSection);
+	for(MeshCacheSection &s : sections) {
+		s.offset = offset = alignOffset(offset);
+		offset += s.size;
+	}
+
+	// Write in a temporary file then rename it so that a concurrent reader never sees a partial cache. The name is unique
+	// to the thread and the process, concurrent writers of the same cache would otherwise interleave their writes.
+	const string cachePath = meshCachePath(filename);
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%016llx.tmp",
+		(unsigned long long) ((uint64_t(random_device()()) << 32) ^ hash<thread::id>()(this_thread::get_id())));
+	const string tmpPath = cachePath + suffix;
+	error_code ec;
+	fs::create_directories(fs::path(cachePath).parent_path(), ec);
+	ofstream out(tmpPath, ios::binary);
+	if(out.fail()) {
+		DEBUG_MSG("WARNING: failed to create mesh cache", tmpPath);
+		return;
+	}
+	out.write((const char*) &header, sizeof(header));
+	out.write((const char*) sections.data(), sections.size() * sizeof(MeshCacheSection));
+	offset = sizeof(header) + sections.size() * sizeof(MeshCacheSection);
+	const char zeros[MESH_CACHE_ALIGNMENT] = {};
+	for(size_t i = 0; i < sections.size(); ++i) {
+		out.write(zeros, sections[i].offset - offset);
+		out.write((const char*) data[i], sections[i].size);
+		offset = sections[i].offset + sections[i].size;
+	}
+	out.close();
+	if(out.fail()) {
+		DEBUG_MSG("WARNING: failed to write mesh cache", tmpPath);
+		fs::remove(tmpPath, ec);
+		return;
+	}
+	fs::rename(tmpPath, cachePath, ec);
+	if(ec) DEBUG_MSG("WARNING: failed to write mesh cache", cachePath);
+}
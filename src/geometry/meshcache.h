@@ -0,0 +1,55 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+// Binary mesh layout (version MESH_CACHE_VERSION, native endianness):
+//   MeshCacheHeader
+//   MeshCacheSection[section_count]
+//   sections data, each one starting on a MESH_CACHE_ALIGNMENT boundary
+// so that every array could be used in place from a mapping of the file.
+// readMeshCache still copies the sections in the arrays of the Mesh, which own their memory: a cache hit saves the
+// parse of the text, not the copy of the data.
+
+constexpr std::uint32_t MESH_CACHE_VERSION = 1u;
+constexpr std::uint64_t MESH_CACHE_ALIGNMENT = 64u;
+// Minimal parse time (in seconds) of a text mesh for readMesh to write its cache
+constexpr double MESH_CACHE_MIN_PARSE_TIME = .1;
+
+struct MeshCacheHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t endianness;
+	std::uint64_t source_size;
+	std::int64_t source_mtime;
+	std::uint32_t section_count;
+	std::uint32_t reserved;
+};
+
+struct MeshCacheSection {
+	enum KIND : std::uint32_t {
+		SOURCE_PATH,
+		POINTS,
+		EDGE_VERTICES,
+		FACET_VERTICES,
+		FACET_OFFSET,
+		POINT_ATTRIBUTE,
+		EDGE_ATTRIBUTE,
+		FACET_ATTRIBUTE,
+		FACET_CORNER_ATTRIBUTE
+	} kind;
+	std::uint32_t attribute_type;
+	std::uint64_t offset, size;
+	char name[48];
+};
+
+// Path of the cache file associated to the mesh file `filename`
+std::string meshCachePath(const char* filename);
+// Fill `m` with the cached version of `filename` if the cache exists and is still valid, the file is mapped then
+// every section is copied in m
+bool readMeshCache(const char* filename, Mesh &m);
+// Write the cache of `filename`, failures only produce a warning
+void writeMeshCache(const char* filename, const Mesh &m);
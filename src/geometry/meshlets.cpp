@@ -0,0 +1,144 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "meshlets.h"
+#include "compact.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// Points of the meshlet being built, in an open addressing table at most half full
+class PointSet {
+public:
+	PointSet() { clear(); }
+
+	inline void clear() {
+		fill(begin(slots), end(slots), EMPTY);
+		count = 0;
+	}
+	inline size_t size() const { return count; }
+	// Insert v, returns false if it already was in the set
+	inline bool insert(const uint32_t v) {
+		for(uint32_t h = (v * 2654435761u) >> (32 - LOG_SIZE);; h = (h + 1) & (SIZE - 1)) {
+			if(slots[h] == v) return false;
+			if(slots[h] == EMPTY) {
+				slots[h] = v;
+				++ count;
+				return true;
+			}
+		}
+	}
+	inline bool contains(const uint32_t v) const {
+		for(uint32_t h = (v * 2654435761u) >> (32 - LOG_SIZE);; h = (h + 1) & (SIZE - 1)) {
+			if(slots[h] == v) return true;
+			if(slots[h] == EMPTY) return false;
+		}
+	}
+
+private:
+	static constexpr uint32_t LOG_SIZE = 7, SIZE = 1u << LOG_SIZE, EMPTY = numeric_limits<uint32_t>::max();
+	static_assert(2 * MESHLET_VERTICES <= SIZE);
+	uint32_t slots[SIZE];
+	size_t count;
+};
+
+// Bounding sphere and normal cone of the triangles [first, end) of indices
+Meshlet bounds(const vec3f* P, const MeshBase &m, const vector<uint32_t> &indices, const size_t first, const size_t end) {
+	const size_t ntriangles = (end - first) / 3;
+	vec3f points[3 * MESHLET_TRIANGLES], normals[MESHLET_TRIANGLES];
+	vec3f lo(numeric_limits<float>::max()), hi(numeric_limits<float>::lowest());
+	for(size_t i = 0; i < 3 * ntriangles; ++i) {
+		const vec3f &p = points[i] = P[m.facet_vertices[indices[first + i]]];
+		for(int k = 0; k < 3; ++k) {
+			lo[k] = min(lo[k], p[k]);
+			hi[k] = max(hi[k], p[k]);
+		}
+	}
+	Meshlet res {
+		.center = .5f * (lo + hi),
+		.radius = 0.f,
+		.coneAxis = vec3f(0.f),
+		.coneCutoff = 2.f,
+		.firstIndex = uint32_t(first),
+		.indexCount = uint32_t(end - first)
+	};
+	float radius2 = 0.f;
+	for(size_t i = 0; i < 3 * ntriangles; ++i) radius2 = max(radius2, (points[i] - res.center).norm2());
+	res.radius = sqrt(radius2);
+
+	// Normals of the triangles are within an angle a of the axis: the cluster faces away from d when the angle between
+	// the axis and d is under pi/2 - a, that is when the cosine is above sin(a)
+	for(size_t t = 0; t < ntriangles; ++t) {
+		vec3f &n = normals[t] = cross(points[3*t+1] - points[3*t], points[3*t+2] - points[3*t]);
+		const float length = n.norm();
+		if(length > 0.f) n /= length;
+		res.coneAxis += n;
+	}
+	const float length = res.coneAxis.norm();
+	if(length <= 0.f) return res;
+	res.coneAxis /= length;
+	float minCos = 1.f;
+	for(size_t t = 0; t < ntriangles; ++t)
+		if(normals[t].norm2() > 0.f) minCos = min(minCos, float(normals[t] * res.coneAxis));
+	if(minCos > 0.f) res.coneCutoff = sqrt(1.f - minCos * minCos);
+	return res;
+}
+
+}
+
+vector<Meshlet> buildMeshlets(const MeshBase &m, vector<uint32_t> &indices) {
+	vector<vec3f> converted;
+	const vec3f* P = m.floatPoints(converted);
+	const Quantization q = quantization(m);
+	float scale[3];
+	for(int k = 0; k < 3; ++k) scale[k] = q.extent[k] > 0.f ? 1.f / q.extent[k] : 0.f;
+
+	const size_t ntriangles = indices.size() / 3;
+	const size_t nthreads = clamp<size_t>(ntriangles / MIN_TRIANGLES_PER_THREAD, 1, threadCount());
+	vector<vector<Meshlet>> meshlets(nthreads);
+	parallelRanges(ntriangles, [&](const size_t t, const size_t begin, const size_t end) {
+		// Sort the triangles of the range by the Morton code of their centroid, in the high bits of their key
+		vector<uint64_t> keys(end - begin);
+		for(size_t i = begin; i < end; ++i) {
+			vec3f c(0.f);
+			for(int k = 0; k < 3; ++k) c += P[m.facet_vertices[indices[3*i+k]]];
+			for(int k = 0; k < 3; ++k) c[k] = (c[k] / 3.f - q.origin[k]) * scale[k];
+			keys[i - begin] = (uint64_t(mortonCell(c, 10)) << 32) | uint64_t(i - begin);
+		}
+		sort(keys.begin(), keys.end());
+		const vector<uint32_t> original(indices.begin() + 3*begin, indices.begin() + 3*end);
+		for(size_t i = 0; i < keys.size(); ++i) {
+			const uint32_t t = uint32_t(keys[i]);
+			for(int k = 0; k < 3; ++k) indices[3*(begin+i)+k] = original[3*t+k];
+		}
+
+		// Cut the sorted triangles when the next one exceeds a limit
+		const uint32_t* v = m.facet_vertices.data();
+		PointSet points;
+		size_t first = begin;
+		for(size_t i = begin; i < end; ++i) {
+			const uint32_t a = v[indices[3*i]], b = v[indices[3*i+1]], c = v[indices[3*i+2]];
+			const size_t added = !points.contains(a) + (b != a && !points.contains(b)) + (c != a && c != b && !points.contains(c));
+			if(i - first == MESHLET_TRIANGLES || points.size() + added > MESHLET_VERTICES) {
+				meshlets[t].push_back(bounds(P, m, indices, 3*first, 3*i));
+				first = i;
+				points.clear();
+			}
+			points.insert(a);
+			points.insert(b);
+			points.insert(c);
+		}
+		if(end > first) meshlets[t].push_back(bounds(P, m, indices, 3*first, 3*end));
+	}, nthreads);
+
+	vector<Meshlet> res;
+	for(const vector<Meshlet> &range : meshlets) res.insert(res.end(), range.begin(), range.end());
+	return res;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+
+// Limits of the clusters of triangles culled as a whole by the GPU
+constexpr std::size_t MESHLET_VERTICES = 64, MESHLET_TRIANGLES = 124;
+
+// Cluster as read by cull.comp (std430). Its triangles face away from the views looking along d when
+// dot(coneAxis, d) > coneCutoff, the cutoff is above 1 when no view sees only their back.
+struct alignas(16) Meshlet {
+	vec3f center;
+	float radius;
+	vec3f coneAxis;
+	float coneCutoff;
+	std::uint32_t firstIndex, indexCount; // Range of the cluster in the triangle indices of the mesh
+};
+
+// Cut the triangles of m, facet corners given three by three in indices, in meshlets of at most MESHLET_VERTICES points
+// and MESHLET_TRIANGLES triangles. Every thread sorts the triangles of a contiguous range along a Morton curve of their
+// centroids then cuts the range in that order, so indices are reordered and the meshlets cover them in order.
+std::vector<Meshlet> buildMeshlets(const MeshBase &m, std::vector<std::uint32_t> &indices);
\ No newline at end of file
@@ -0,0 +1,83 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "normals.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+VertexCorners buildVertexCorners(const MeshBase &m) {
+	const size_t nverts = m.nverts();
+	const size_t ncorners = m.facet_vertices.size();
+	VertexCorners res;
+	res.offset.assign(nverts + 1, 0u);
+	res.corners.resize(ncorners);
+
+	// Count the corners of each vertex, then prefix sums
+	parallelRanges(ncorners, [&](size_t, size_t begin, size_t end) {
+		for(size_t fc = begin; fc < end; ++fc)
+			atomic_ref<uint32_t>(res.offset[m.facet_vertices[fc] + 1]).fetch_add(1u, memory_order_relaxed);
+	});
+	for(size_t v = 0; v < nverts; ++v) res.offset[v+1] += res.offset[v];
+
+	// Fill the rows, their order depends on the scheduling so each row is sorted afterwards
+	// to keep the normals deterministic
+	vector<uint32_t> cursor(res.offset.begin(), res.offset.end() - 1);
+	parallelRanges(ncorners, [&](size_t, size_t begin, size_t end) {
+		for(size_t fc = begin; fc < end; ++fc)
+			res.corners[atomic_ref<uint32_t>(cursor[m.facet_vertices[fc]]).fetch_add(1u, memory_order_relaxed)] = fc;
+	});
+	parallelFor(nverts, [&](size_t v) {
+		sort(res.corners.begin() + res.offset[v], res.corners.begin() + res.offset[v+1]);
+	});
+	return res;
+}
+
+template<typename M>
+vector<vec3> computeSmoothNormals(const M &m, const VertexCorners &adjacency) {
+	// Weighted normal of each corner, written once by the thread owning its facet.
+	// Corners are sent to the kernel by chunks, consecutive corners may belong to different facets.
+	// Compact points are decoded chunk by chunk, for the three vertices of every corner.
+	vector<vec3> weighted(m.nfacet_corners());
+	parallelRanges(m.nfacets(), [&](size_t, size_t begin, size_t end) {
+		vector<vec3> decoded(m.precision() == Precision::DOUBLE ? 0u : 3u * simd::CHUNK_SIZE);
+		uint32_t prev[simd::CHUNK_SIZE], cur[simd::CHUNK_SIZE], next[simd::CHUNK_SIZE];
+		uint32_t first = m.facet_begin(begin), count = 0;
+		const auto flush = [&]() {
+			copy_n(m.facet_vertices.data() + first, count, cur);
+			const vec3* P = m.doublePoints(prev, count, decoded.data());
+			m.doublePoints(cur, count, decoded.data(), simd::CHUNK_SIZE);
+			m.doublePoints(next, count, decoded.data(), 2u * simd::CHUNK_SIZE);
+			simd::cornerNormals(P, prev, cur, next, count, true, weighted.data() + first);
+			first += count;
+			count = 0;
+		};
+		for(uint32_t f = begin; f < end; ++f) for(uint32_t fc = m.facet_begin(f); fc < m.facet_end(f); ++fc) {
+			prev[count] = m.facet_vertices[m.prev(f, fc)];
+			next[count] = m.facet_vertices[m.next(f, fc)];
+			if(++count == simd::CHUNK_SIZE) flush();
+		}
+		flush();
+	});
+
+	// Gather the corners of each vertex
+	vector<vec3> normals(m.nverts());
+	parallelRanges(m.nverts(), [&](size_t, size_t begin, size_t end) {
+		for(size_t v = begin; v < end; ++v) {
+			vec3 n(0.);
+			for(uint32_t i = adjacency.offset[v]; i < adjacency.offset[v+1]; ++i) n += weighted[adjacency.corners[i]];
+			normals[v] = n;
+		}
+		simd::normalize(normals.data() + begin, end - begin);
+	});
+	return normals;
+}
+
+template vector<vec3> computeSmoothNormals(const Mesh&, const VertexCorners&);
+template vector<vec3> computeSmoothNormals(const TriMesh&, const VertexCorners&);
+template vector<vec3> computeSmoothNormals(const QuadMesh&, const VertexCorners&);
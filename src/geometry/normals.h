@@ -0,0 +1,28 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+// Corners around each vertex in compressed rows: the corners of vertex v are
+// corners[offset[v]], ..., corners[offset[v+1]-1] in increasing order.
+struct VertexCorners {
+	std::vector<std::uint32_t> offset;
+	std::vector<std::uint32_t> corners;
+
+	inline bool empty() const { return offset.empty(); }
+};
+
+// Build the vertex to corner adjacency of m in parallel, it only depends on the connectivity
+VertexCorners buildVertexCorners(const MeshBase &m);
+
+// Angle weighted average of the normals of the facets around each vertex.
+// Corner contributions are computed in parallel over facets with the kernels of simd.h, then gathered
+// in parallel over vertices through the adjacency, so no two threads write the same normal.
+// Instantiated for Mesh, TriMesh and QuadMesh.
+template<typename M>
+std::vector<vec3> computeSmoothNormals(const M &m, const VertexCorners &adjacency);
+template<typename M>
+inline std::vector<vec3> computeSmoothNormals(const M &m) { return computeSmoothNormals(m, buildVertexCorners(m)); }
@@ -0,0 +1,309 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "readers.h"
+#include "mappedfile.h"
+#include "debug.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+enum class PLYType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+struct PLYProperty {
+	string name;
+	PLYType type;
+	bool list = false;
+	PLYType countType;
+	size_t offset = 0; // Offset in the element record, only meaningful for fixed size elements
+};
+
+struct PLYElement {
+	string name;
+	size_t count;
+	vector<PLYProperty> properties;
+	size_t stride = 0; // Record size, 0 if the element has list properties
+	const char* data = nullptr;
+
+	inline const PLYProperty* find(string_view prop) const {
+		auto it = ranges::find(properties, prop, &PLYProperty::name);
+		return it == properties.end() ? nullptr : &*it;
+	}
+};
+
+bool parseType(string_view s, PLYType &t) {
+	if(s == "char" || s == "int8") t = PLYType::INT8;
+	else if(s == "uchar" || s == "uint8") t = PLYType::UINT8;
+	else if(s == "short" || s == "int16") t = PLYType::INT16;
+	else if(s == "ushort" || s == "uint16") t = PLYType::UINT16;
+	else if(s == "int" || s == "int32") t = PLYType::INT32;
+	else if(s == "uint" || s == "uint32") t = PLYType::UINT32;
+	else if(s == "float" || s == "float32") t = PLYType::FLOAT32;
+	else if(s == "double" || s == "float64") t = PLYType::FLOAT64;
+	else return false;
+	return true;
+}
+
+inline size_t typeSize(const PLYType t) {
+	switch(t) {
+		case PLYType::INT8: case PLYType::UINT8: return 1;
+		case PLYType::INT16: case PLYType::UINT16: return 2;
+		case PLYType::INT32: case PLYType::UINT32: case PLYType::FLOAT32: return 4;
+		case PLYType::FLOAT64: return 8;
+	}
+	return 0;
+}
+
+inline bool isFloating(const PLYType t) { return t == PLYType::FLOAT32 || t == PLYType::FLOAT64; }
+
+template<typename T>
+inline T load(const char* p, const bool swap) {
+	T x;
+	if(swap) {
+		char bytes[sizeof(T)];
+		reverse_copy(p, p + sizeof(T), bytes);
+		memcpy(&x, bytes, sizeof(T));
+	} else memcpy(&x, p, sizeof(T));
+	return x;
+}
+
+template<typename T>
+inline T readValue(const char* p, const PLYType t, const bool swap) {
+	switch(t) {
+		case PLYType::INT8: return T(load<int8_t>(p, swap));
+		case PLYType::UINT8: return T(load<uint8_t>(p, swap));
+		case PLYType::INT16: return T(load<int16_t>(p, swap));
+		case PLYType::UINT16: return T(load<uint16_t>(p, swap));
+		case PLYType::INT32: return T(load<int32_t>(p, swap));
+		case PLYType::UINT32: return T(load<uint32_t>(p, swap));
+		case PLYType::FLOAT32: return T(load<float>(p, swap));
+		case PLYType::FLOAT64: return T(load<double>(p, swap));
+	}
+	return T(0);
+}
+
+inline string_view nextWord(string_view &line) {
+	const size_t b = line.find_first_not_of(" \t\r");
+	if(b == string_view::npos) return line = string_view();
+	line.remove_prefix(b);
+	const size_t e = min(line.find_first_of(" \t\r"), line.size());
+	const string_view word = line.substr(0, e);
+	line.remove_prefix(e);
+	return word;
+}
+
+// Fill an attribute from a fixed offset property of every record of a fixed size element
+Attribute makeAttribute(const PLYElement &e, const PLYProperty &p, const bool swap) {
+	Attribute a(p.name, isFloating(p.type) ? Attribute::SCALAR : Attribute::INTEGER);
+	if(a.type == Attribute::SCALAR) a.u.resize(e.count);
+	else a.iu.resize(e.count);
+	parallelRanges(e.count, [&](size_t, size_t begin, size_t end) {
+		const char* rec = e.data + begin * e.stride + p.offset;
+		for(size_t i = begin; i < end; ++i, rec += e.stride) {
+			if(a.type == Attribute::SCALAR) a.u[i] = readValue<double>(rec, p.type, swap);
+			else a.iu[i] = readValue<int64_t>(rec, p.type, swap);
+		}
+	});
+	return a;
+}
+
+}
+
+Mesh readPLY(const char* filename) {
+	Timer timer;
+	const MappedFile file(filename);
+	const auto error = [&](const string &what) {
+		THROW_ERROR("Invalid PLY file '" + string(filename) + "': " + what);
+	};
+
+	// Header, read line by line up to the line made of end_header alone since comments may hold any word
+	string_view header = file.view();
+	const char* body = nullptr;
+	bool swap = false, hasFormat = false;
+	vector<PLYElement> elements;
+	for(size_t l = 0; !body; ++l) {
+		const size_t eol = header.find('\n');
+		string_view line = header.substr(0, eol);
+		header.remove_prefix(eol == string_view::npos ? header.size() : eol + 1);
+		const string_view key = nextWord(line);
+		string_view rest = line;
+		const bool alone = nextWord(rest).empty();
+		if(l == 0) {
+			if(key != "ply" || !alone) error("missing header");
+		} else if(key == "end_header" && alone) {
+			if(eol == string_view::npos) error("missing data");
+			body = header.data();
+		} else if(eol == string_view::npos) error("missing header");
+		else if(key == "format") {
+			hasFormat = true;
+			const string_view format = nextWord(line);
+			if(format == "binary_little_endian") swap = endian::native != endian::little;
+			else if(format == "binary_big_endian") swap = endian::native != endian::big;
+			else error("only binary PLY files are supported");
+		} else if(key == "element") {
+			PLYElement &e = elements.emplace_back();
+			e.name = nextWord(line);
+			const string_view count = nextWord(line);
+			if(from_chars(count.data(), count.data() + count.size(), e.count).ec != errc()) error("bad element count");
+		} else if(key == "property") {
+			if(elements.empty()) error("property outside of an element");
+			PLYProperty &p = elements.back().properties.emplace_back();
+			string_view type = nextWord(line);
+			if(type == "list") {
+				p.list = true;
+				if(!parseType(nextWord(line), p.countType)) error("bad list count type");
+				type = nextWord(line);
+			}
+			if(!parseType(type, p.type)) error("unknown property type " + string(type));
+			p.name = nextWord(line);
+		}
+	}
+	if(!hasFormat) error("missing format");
+
+	// Locate element records, list counts are needed to know the size of variable records
+	Mesh m;
+	const char* ptr = body;
+	const char* const end = file.end();
+	const PLYElement *vertices = nullptr, *faces = nullptr, *edges = nullptr;
+	vector<const char*> face_records;
+	for(PLYElement &e : elements) {
+		e.data = ptr;
+		e.stride = 0;
+		bool fixed = true;
+		for(PLYProperty &p : e.properties) {
+			if(p.list) fixed = false;
+			p.offset = e.stride;
+			e.stride += typeSize(p.type);
+		}
+		const bool isFace = e.name == "face";
+		if(isFace) {
+			face_records.resize(e.count);
+			m.facet_offset.resize(e.count + 1);
+		}
+		if(fixed) {
+			if(e.stride && e.count > size_t(end - ptr) / e.stride) error("truncated element " + e.name);
+			ptr += e.count * e.stride;
+		} else {
+			e.stride = 0;
+			const PLYProperty* corners = e.find("vertex_indices");
+			if(!corners) corners = e.find("vertex_index");
+			for(size_t i = 0; i < e.count; ++i) {
+				if(isFace) face_records[i] = ptr;
+				for(const PLYProperty &p : e.properties) {
+					size_t size = typeSize(p.type);
+					if(p.list) {
+						const size_t countSize = typeSize(p.countType);
+						if(size_t(end - ptr) < countSize) error("truncated element " + e.name);
+						const size_t n = readValue<size_t>(ptr, p.countType, swap);
+						if(isFace && &p == corners) {
+							if(n > UINT32_MAX - m.facet_offset[i]) error("too many facet corners");
+							m.facet_offset[i+1] = m.facet_offset[i] + n;
+						}
+						ptr += countSize;
+						size *= n;
+					}
+					if(size_t(end - ptr) < size) error("truncated element " + e.name);
+					ptr += size;
+				}
+			}
+		}
+		if(e.name == "vertex") vertices = &e;
+		else if(isFace) faces = &e;
+		else if(e.name == "edge") edges = &e;
+	}
+
+	// Vertices
+	if(vertices) {
+		const PLYElement &e = *vertices;
+		if(!e.stride && e.count) error("list properties are not supported on vertices");
+		const PLYProperty* xyz[3] { e.find("x"), e.find("y"), e.find("z") };
+		if(!xyz[0] || !xyz[1] || !xyz[2]) error("vertices need x, y and z properties");
+		m.points.resize(e.count);
+		parallelRanges(e.count, [&](size_t, size_t begin, size_t stop) {
+			const char* rec = e.data + begin * e.stride;
+			for(size_t i = begin; i < stop; ++i, rec += e.stride)
+				for(int k = 0; k < 3; ++k)
+					m.points[i][k] = readValue<double>(rec + xyz[k]->offset, xyz[k]->type, swap);
+		});
+		for(const PLYProperty &p : e.properties)
+			if(&p != xyz[0] && &p != xyz[1] && &p != xyz[2])
+				m.point_attributes.push_back(makeAttribute(e, p, swap));
+	}
+
+	// Faces
+	if(faces) {
+		const PLYElement &e = *faces;
+		const PLYProperty* corners = e.find("vertex_indices");
+		if(!corners) corners = e.find("vertex_index");
+		if(!corners || !corners->list) error("faces need a vertex_indices list property");
+		m.facet_vertices.resize(m.facet_offset.back());
+		vector<Attribute*> attributes(e.properties.size(), nullptr);
+		m.facet_attributes.reserve(e.properties.size());
+		for(size_t k = 0; k < e.properties.size(); ++k) if(!e.properties[k].list) {
+			const PLYProperty &p = e.properties[k];
+			attributes[k] = &m.facet_attributes.emplace_back(p.name, isFloating(p.type) ? Attribute::SCALAR : Attribute::INTEGER);
+		}
+		for(Attribute *a : attributes) if(a) {
+			if(a->type == Attribute::SCALAR) a->u.resize(e.count);
+			else a->iu.resize(e.count);
+		}
+		const size_t nverts = m.nverts();
+		parallelRanges(e.count, [&](size_t, size_t begin, size_t stop) {
+			for(size_t f = begin; f < stop; ++f) {
+				const char* rec = face_records[f];
+				for(size_t k = 0; k < e.properties.size(); ++k) {
+					const PLYProperty &p = e.properties[k];
+					const size_t size = typeSize(p.type);
+					if(p.list) {
+						const size_t n = readValue<size_t>(rec, p.countType, swap);
+						rec += typeSize(p.countType);
+						if(&p == corners) for(size_t i = 0; i < n; ++i, rec += size) {
+							const int64_t v = readValue<int64_t>(rec, p.type, swap);
+							if(v < 0 || size_t(v) >= nverts) error("invalid vertex index in face " + to_string(f));
+							m.facet_vertices[m.facet_offset[f] + i] = v;
+						} else rec += n * size;
+					} else {
+						Attribute &a = *attributes[k];
+						if(a.type == Attribute::SCALAR) a.u[f] = readValue<double>(rec, p.type, swap);
+						else a.iu[f] = readValue<int64_t>(rec, p.type, swap);
+						rec += size;
+					}
+				}
+			}
+		});
+	}
+
+	// Edges
+	if(edges && edges->stride) {
+		const PLYElement &e = *edges;
+		const PLYProperty *v1 = e.find("vertex1"), *v2 = e.find("vertex2");
+		if(v1 && v2) {
+			m.edge_vertices.resize(2 * e.count);
+			const char* rec = e.data;
+			for(size_t i = 0; i < e.count; ++i, rec += e.stride) {
+				const int64_t a = readValue<int64_t>(rec + v1->offset, v1->type, swap);
+				const int64_t b = readValue<int64_t>(rec + v2->offset, v2->type, swap);
+				if(a < 0 || b < 0 || size_t(a) >= m.nverts() || size_t(b) >= m.nverts()) error("invalid vertex index in edge " + to_string(i));
+				m.edge_vertices[2*i] = a;
+				m.edge_vertices[2*i+1] = b;
+			}
+			for(const PLYProperty &p : e.properties)
+				if(&p != v1 && &p != v2) m.edge_attributes.push_back(makeAttribute(e, p, swap));
+		}
+	}
+
+	[[maybe_unused]] const double time = timer.elapsed();
+	PRINT_INFO("PLY", filename, "read in", time, "s:",
+				file.size() / (1e6 * time), "MB/s,", m.nfacets() / time, "facets/s");
+	return m;
+}
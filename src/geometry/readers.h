@@ -0,0 +1,12 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+// Format specific readers used by readMesh
+Mesh readOBJ(const char* filename);
+Mesh readPLY(const char* filename);
+Mesh readSTL(const char* filename);
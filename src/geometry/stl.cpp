@@ -0,0 +1,141 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "readers.h"
+#include "mappedfile.h"
+#include "debug.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <atomic>
+#include <bit>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+template<typename T>
+inline T loadLE(const char* p) {
+	T x;
+	if constexpr (endian::native == endian::little) memcpy(&x, p, sizeof(T));
+	else {
+		char bytes[sizeof(T)];
+		reverse_copy(p, p + sizeof(T), bytes);
+		memcpy(&x, bytes, sizeof(T));
+	}
+	return x;
+}
+
+inline uint64_t hashPoint(const vec3f &p) {
+	uint64_t h = bit_cast<uint32_t>(p.x) * 0x9e3779b97f4a7c15ull;
+	h ^= bit_cast<uint32_t>(p.y) * 0xc2b2ae3d27d4eb4full;
+	h ^= bit_cast<uint32_t>(p.z) * 0x165667b19e3779f9ull;
+	return h ^ (h >> 29);
+}
+
+inline bool samePoint(const vec3f &a, const vec3f &b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Merge the corners sharing the same position.
+// Corners are dispatched in buckets according to their hash, then each bucket is deduplicated
+// independently with an open addressing table. Vertices are numbered in order of first appearance.
+vector<uint32_t> weldCorners(const vector<vec3f> &corners, vector<vec3> &points) {
+	const size_t n = corners.size();
+	const size_t nthreads = min(threadCount(), max<size_t>(n, 1));
+	const size_t nbuckets = 8 * nthreads;
+
+	// Count corners of each bucket in each thread range
+	vector<uint64_t> hashes(n);
+	vector<size_t> counts(nthreads * nbuckets, 0);
+	parallelRanges(n, [&](size_t t, size_t begin, size_t end) {
+		size_t* count = counts.data() + t * nbuckets;
+		for(size_t i = begin; i < end; ++i) ++ count[(hashes[i] = hashPoint(corners[i])) % nbuckets];
+	}, nthreads);
+
+	// Prefix sums ordered by bucket then by thread so that buckets keep corners in increasing order
+	vector<size_t> bucketStart(nbuckets + 1);
+	size_t offset = 0;
+	for(size_t b = 0; b < nbuckets; ++b) {
+		bucketStart[b] = offset;
+		for(size_t t = 0; t < nthreads; ++t) {
+			const size_t c = counts[t * nbuckets + b];
+			counts[t * nbuckets + b] = offset;
+			offset += c;
+		}
+	}
+	bucketStart[nbuckets] = offset;
+	vector<uint32_t> sorted(n);
+	parallelRanges(n, [&](size_t t, size_t begin, size_t end) {
+		size_t* pos = counts.data() + t * nbuckets;
+		for(size_t i = begin; i < end; ++i) sorted[pos[hashes[i] % nbuckets]++] = i;
+	}, nthreads);
+
+	// Find the first corner with the same position of every corner
+	vector<uint32_t> first(n);
+	parallelFor(nbuckets, [&](size_t b) {
+		const size_t size = bucketStart[b+1] - bucketStart[b];
+		const size_t mask = bit_ceil(2 * size + 1) - 1;
+		vector<uint32_t> table(mask + 1, UINT32_MAX);
+		for(size_t j = bucketStart[b]; j < bucketStart[b+1]; ++j) {
+			const uint32_t i = sorted[j];
+			size_t slot = (hashes[i] / nbuckets) & mask;
+			while(table[slot] != UINT32_MAX && !samePoint(corners[table[slot]], corners[i])) slot = (slot + 1) & mask;
+			if(table[slot] == UINT32_MAX) table[slot] = i;
+			first[i] = table[slot];
+		}
+	});
+
+	// Number vertices
+	vector<uint32_t> ids(n);
+	points.clear();
+	for(size_t i = 0; i < n; ++i) {
+		if(first[i] == i) {
+			ids[i] = points.size();
+			points.emplace_back(corners[i]);
+		} else ids[i] = ids[first[i]];
+	}
+	return ids;
+}
+
+}
+
+Mesh readSTL(const char* filename) {
+	Timer timer;
+	const MappedFile file(filename);
+	if(file.size() < 84) THROW_ERROR(string("Invalid STL file: ") + filename);
+	const uint64_t ntris = loadLE<uint32_t>(file.data() + 80);
+	if(84 + 50 * ntris != file.size())
+		THROW_ERROR(string("Only binary STL files are supported: ") + filename);
+	if(3 * ntris > UINT32_MAX) THROW_ERROR(string("Too many triangles in STL file: ") + filename);
+
+	// Read triangle soup
+	vector<vec3f> corners(3 * ntris);
+	Attribute attribute("attribute", Attribute::INTEGER);
+	attribute.iu.resize(ntris);
+	atomic<bool> hasAttribute = false;
+	parallelRanges(ntris, [&](size_t, size_t begin, size_t end) {
+		bool nonZero = false;
+		const char* rec = file.data() + 84 + 50 * begin;
+		for(size_t t = begin; t < end; ++t, rec += 50) {
+			for(int c = 0; c < 3; ++c) for(int k = 0; k < 3; ++k)
+				corners[3*t+c][k] = loadLE<float>(rec + 12 * (c+1) + 4 * k) + 0.f; // + 0.f turns -0 into +0
+			if((attribute.iu[t] = loadLE<uint16_t>(rec + 48))) nonZero = true;
+		}
+		if(nonZero) hasAttribute = true;
+	});
+
+	Mesh m;
+	m.facet_vertices = weldCorners(corners, m.points);
+	m.facet_offset.resize(ntris + 1);
+	for(uint32_t t = 0; t <= ntris; ++t) m.facet_offset[t] = 3 * t;
+	if(hasAttribute) m.facet_attributes.push_back(std::move(attribute));
+
+	[[maybe_unused]] const double time = timer.elapsed();
+	PRINT_INFO("STL", filename, "read in", time, "s:",
+				file.size() / (1e6 * time), "MB/s,", m.nfacets() / time, "facets/s,",
+				m.nverts(), "vertices after welding");
+	return m;
+}
@@ -0,0 +1,132 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "triangulation.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+// Facets handled by a thread at least, so that small ranges do not pay for thread creation
+constexpr size_t MIN_FACETS_PER_THREAD = 1u << 12;
+
+template<typename M>
+inline size_t triangleCount(const M &m, const size_t f) {
+	const size_t n = m.facet_end(f) - m.facet_begin(f);
+	return n < 3 ? 0 : n - 2;
+}
+
+inline double cross2(const vec2 &a, const vec2 &b) { return a.x * b.y - a.y * b.x; }
+
+inline bool inTriangle(const vec2 &p, const vec2 &a, const vec2 &b, const vec2 &c) {
+	return cross2(b - a, p - a) >= 0. && cross2(c - b, p - b) >= 0. && cross2(a - c, p - c) >= 0.;
+}
+
+struct Scratch {
+	vector<vec2> points;
+	vector<uint32_t> remaining;
+};
+
+// Write the triangles of the polygon f in out and return the end of the written triangles
+template<typename M>
+uint32_t* triangulateFacet(const M &m, const uint32_t f, uint32_t* out, Scratch &scratch) {
+	const uint32_t fc0 = m.facet_begin(f);
+	const uint32_t n = m.facet_end(f) - fc0;
+	const auto fan = [&]() {
+		for(uint32_t i = 1; i+1 < n; ++i) {
+			*(out++) = fc0;
+			*(out++) = fc0 + i;
+			*(out++) = fc0 + i + 1;
+		}
+		return out;
+	};
+	if(n <= 3) return fan();
+
+	// Project the polygon in 2D so that it is counterclockwise
+	vec3 normal(0.);
+	for(uint32_t i = 0; i < n; ++i) {
+		const vec3 p = m.corner_point(fc0 + i);
+		const vec3 q = m.corner_point(fc0 + (i+1) % n);
+		normal += cross(p, q);
+	}
+	int axis = 0;
+	for(int k = 1; k < 3; ++k) if(std::abs(normal[k]) > std::abs(normal[axis])) axis = k;
+	const double sign = normal[axis] < 0. ? -1. : 1.;
+	vector<vec2> &P = scratch.points;
+	P.resize(n);
+	for(uint32_t i = 0; i < n; ++i) {
+		const vec3 p = m.corner_point(fc0 + i);
+		P[i] = vec2(sign * p[(axis+1) % 3], p[(axis+2) % 3]);
+	}
+
+	// Convex polygons are split in fans
+	bool convex = true;
+	for(uint32_t i = 0; i < n && convex; ++i)
+		convex = cross2(P[i] - P[(i+n-1) % n], P[(i+1) % n] - P[i]) >= 0.;
+	if(convex) return fan();
+
+	// Ear clipping
+	vector<uint32_t> &V = scratch.remaining;
+	V.resize(n);
+	iota(V.begin(), V.end(), 0u);
+	const auto emit = [&](const uint32_t a, const uint32_t b, const uint32_t c) {
+		*(out++) = fc0 + a;
+		*(out++) = fc0 + b;
+		*(out++) = fc0 + c;
+	};
+	while(V.size() > 3) {
+		const size_t k = V.size();
+		size_t ear = k;
+		for(size_t i = 0; i < k && ear == k; ++i) {
+			const vec2 &a = P[V[(i+k-1) % k]], &b = P[V[i]], &c = P[V[(i+1) % k]];
+			if(cross2(b - a, c - b) <= 0.) continue;
+			bool empty = true;
+			for(size_t j = 0; j < k && empty; ++j)
+				if(j != i && j != (i+1) % k && j != (i+k-1) % k) empty = !inTriangle(P[V[j]], a, b, c);
+			if(empty) ear = i;
+		}
+		// Degenerate polygons have no ear, their first corner is clipped
+		if(ear == k) ear = 0;
+		emit(V[(ear+k-1) % k], V[ear], V[(ear+1) % k]);
+		V.erase(V.begin() + ear);
+	}
+	emit(V[0], V[1], V[2]);
+	return out;
+}
+
+}
+
+template<typename M>
+vector<uint32_t> triangulateFacets(const M &m, const size_t f0, const size_t f1) {
+	if constexpr (M::ARITY == 3) {
+		vector<uint32_t> triangles(3 * (f1 - f0));
+		iota(triangles.begin(), triangles.end(), m.facet_begin(f0));
+		return triangles;
+	}
+	const size_t n = f1 - f0;
+	const size_t nthreads = min(threadCount(), n / MIN_FACETS_PER_THREAD + 1);
+
+	// Triangles of each range then prefix sums
+	vector<size_t> offset(nthreads + 1, 0);
+	parallelRanges(n, [&](size_t t, size_t begin, size_t end) {
+		for(size_t f = f0 + begin; f < f0 + end; ++f) offset[t+1] += triangleCount(m, f);
+	}, nthreads);
+	partial_sum(offset.begin(), offset.end(), offset.begin());
+
+	vector<uint32_t> triangles(3 * offset.back());
+	parallelRanges(n, [&](size_t t, size_t begin, size_t end) {
+		Scratch scratch;
+		uint32_t* out = triangles.data() + 3 * offset[t];
+		for(size_t f = f0 + begin; f < f0 + end; ++f) out = triangulateFacet(m, f, out, scratch);
+	}, nthreads);
+	return triangles;
+}
+
+template vector<uint32_t> triangulateFacets(const Mesh&, size_t, size_t);
+template vector<uint32_t> triangulateFacets(const TriMesh&, size_t, size_t);
+template vector<uint32_t> triangulateFacets(const QuadMesh&, size_t, size_t);
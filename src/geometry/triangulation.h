@@ -0,0 +1,14 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "mesh.h"
+
+// Triangulate the facets [f0, f1) in parallel, three corner indices are returned per triangle.
+// Triangles and convex polygons are split in fans, other polygons are ear clipped in the plane
+// of their Newell normal. Triangles keep the orientation of their facet.
+// Instantiated for Mesh, TriMesh and QuadMesh, triangles of a TriMesh are simply its corners.
+template<typename M>
+std::vector<std::uint32_t> triangulateFacets(const M &m, std::size_t f0, std::size_t f1);
@@ -0,0 +1,212 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "allocator.h"
+
+#include "debug.h"
+
+#include <algorithm>
+
+namespace gfx {
+
+// Size of the blocks of the heaps big enough, smaller heaps use an eighth of their size
+static constexpr VkDeviceSize BLOCK_SIZE = VkDeviceSize(64) << 20;
+
+void RangeAllocator::grow(const VkDeviceSize size) {
+	if(size <= capacity) return;
+	insertFree(capacity, size);
+	capacity = size;
+}
+
+bool RangeAllocator::allocate(const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize &offset) {
+	// Smallest free range that holds the aligned allocation
+	for(auto it = freeBySize.lower_bound(size); it != freeBySize.end(); ++it) {
+		const VkDeviceSize begin = it->second, end = begin + it->first;
+		const VkDeviceSize aligned = (begin + alignment - 1u) & ~(alignment - 1u);
+		if(aligned + size > end) continue;
+		freeByOffset.erase(begin);
+		freeBySize.erase(it);
+		if(aligned > begin) insertFree(begin, aligned);
+		if(aligned + size < end) insertFree(aligned + size, end);
+		offset = aligned;
+		usedSize += size;
+		++ count;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::release(const VkDeviceSize offset, const VkDeviceSize size) {
+	insertFree(offset, offset + size);
+	usedSize -= size;
+	-- count;
+}
+
+void RangeAllocator::insertFree(VkDeviceSize begin, VkDeviceSize end) {
+	// Merge with the free neighbours
+	auto next = freeByOffset.lower_bound(begin);
+	if(next != freeByOffset.end() && next->first == end) {
+		end += next->second;
+		eraseFree(next++);
+	}
+	if(next != freeByOffset.begin()) {
+		const auto prev = std::prev(next);
+		if(prev->first + prev->second == begin) {
+			begin = prev->first;
+			eraseFree(prev);
+		}
+	}
+	freeByOffset.emplace(begin, end - begin);
+	freeBySize.emplace(end - begin, begin);
+}
+
+void RangeAllocator::eraseFree(const std::map<VkDeviceSize, VkDeviceSize>::iterator it) {
+	auto [first, last] = freeBySize.equal_range(it->second);
+	while(first != last && first->second != it->first) ++ first;
+	ASSERT(first != last);
+	freeBySize.erase(first);
+	freeByOffset.erase(it);
+}
+
+void MemoryAllocator::init(VkPhysicalDevice gpu, VkDevice device) {
+	clean();
+	this->device = device;
+	vkGetPhysicalDeviceMemoryProperties(gpu, &properties);
+	for(uint32_t t = 0; t < properties.memoryTypeCount; ++t)
+		blockSizes[t] = std::min(BLOCK_SIZE, properties.memoryHeaps[properties.memoryTypes[t].heapIndex].size / 8u);
+}
+
+void MemoryAllocator::clean() {
+	if(!device) return;
+	for(Pool &pool : pools) {
+		for(uint32_t b = 0; b < pool.size(); ++b) if(pool[b]) {
+			if(pool[b]->allocations()) DEBUG_MSG("Memory block freed with", pool[b]->allocations(), "allocations");
+			vkFreeMemory(device, pool[b]->memory, nullptr);
+		}
+		pool.clear();
+	}
+	device = nullptr;
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, const uint32_t memoryType, const bool linear) {
+	const std::lock_guard lock(mutex);
+	Allocation allocation {
+		.size = requirements.size,
+		.pool = 2u * memoryType + linear
+	};
+	Pool &pool = pools[allocation.pool];
+	const auto take = [&](const uint32_t b) {
+		allocation.memory = pool[b]->memory;
+		allocation.block = b;
+		if(pool[b]->mapped) allocation.mapped = static_cast<char*>(pool[b]->mapped) + allocation.offset;
+		return allocation;
+	};
+
+	const bool dedicated = requirements.size > blockSizes[memoryType] / 2u;
+	if(!dedicated) for(uint32_t b = 0; b < pool.size(); ++b)
+		if(pool[b] && !pool[b]->dedicated && !pool[b]->evacuated && pool[b]->allocate(requirements.size, requirements.alignment, allocation.offset))
+			return take(b);
+
+	// New block in the first free slot
+	auto block = std::make_unique<Block>();
+	block->grow(dedicated ? requirements.size : blockSizes[memoryType]);
+	block->dedicated = dedicated;
+	const VkMemoryAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = block->size(),
+		.memoryTypeIndex = memoryType
+	};
+	if(vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+		THROW_ERROR("failed to allocate device memory!");
+	if(properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		vkMapMemory(device, block->memory, 0u, VK_WHOLE_SIZE, 0u, &block->mapped);
+	block->allocate(requirements.size, requirements.alignment, allocation.offset);
+
+	const uint32_t b = std::find(pool.begin(), pool.end(), nullptr) - pool.begin();
+	if(b == pool.size()) pool.push_back(std::move(block));
+	else pool[b] = std::move(block);
+	return take(b);
+}
+
+void MemoryAllocator::free(Allocation &allocation) {
+	if(!allocation) return;
+	const std::lock_guard lock(mutex);
+	Pool &pool = pools[allocation.pool];
+	const uint32_t b = allocation.block;
+	Block &block = *pool[b];
+	block.release(allocation.offset, allocation.size);
+	allocation = {};
+	if(block.allocations()) return;
+	// A pool keeps one empty block for the next allocations
+	const auto spare = [&](const std::unique_ptr<Block> &other) {
+		return other && other.get() != &block && !other->dedicated && !other->allocations();
+	};
+	if(block.dedicated || block.evacuated || std::ranges::any_of(pool, spare)) destroyBlock(pool, b);
+}
+
+void MemoryAllocator::destroyBlock(Pool &pool, const uint32_t block) {
+	vkFreeMemory(device, pool[block]->memory, nullptr);
+	pool[block].reset();
+	while(!pool.empty() && !pool.back()) pool.pop_back();
+}
+
+uint32_t MemoryAllocator::beginDefragmentation() {
+	const std::lock_guard lock(mutex);
+	uint32_t count = 0u;
+	for(Pool &pool : pools) {
+		// The sparsest blocks are evacuated first, as long as the free memory of the others can receive their allocations.
+		// Free memory split in ranges too small may still need a new block.
+		std::vector<Block*> blocks;
+		VkDeviceSize free = 0u;
+		for(const std::unique_ptr<Block> &block : pool) if(block && !block->dedicated) {
+			free += block->size() - block->used();
+			if(block->allocations()) blocks.push_back(block.get());
+		}
+		std::ranges::sort(blocks, {}, &Block::used);
+		for(Block *block : blocks) {
+			free -= block->size() - block->used();
+			if(block->used() > free) break;
+			free -= block->used();
+			block->evacuated = true;
+			++ count;
+		}
+	}
+	return count;
+}
+
+bool MemoryAllocator::isEvacuated(const Allocation &allocation) const {
+	if(!allocation) return false;
+	const std::lock_guard lock(mutex);
+	return pools[allocation.pool][allocation.block]->evacuated;
+}
+
+void MemoryAllocator::endDefragmentation() {
+	const std::lock_guard lock(mutex);
+	for(Pool &pool : pools) for(uint32_t b = 0; b < pool.size(); ++b) if(pool[b] && pool[b]->evacuated) {
+		// Resources that could not move keep their block
+		if(pool[b]->allocations()) pool[b]->evacuated = false;
+		else destroyBlock(pool, b);
+	}
+}
+
+std::vector<MemoryStats> MemoryAllocator::stats() const {
+	const std::lock_guard lock(mutex);
+	std::vector<MemoryStats> res;
+	for(uint32_t t = 0; t < properties.memoryTypeCount; ++t) {
+		MemoryStats s { .memoryType = t, .properties = properties.memoryTypes[t].propertyFlags };
+		for(const uint32_t p : { 2*t, 2*t+1 })
+			for(const std::unique_ptr<Block> &block : pools[p]) if(block) {
+				++ s.blocks;
+				s.allocations += block->allocations();
+				s.reserved += block->size();
+				s.used += block->used();
+				s.largestFree = std::max(s.largestFree, block->largestFree());
+			}
+		if(s.blocks) res.push_back(s);
+	}
+	return res;
+}
+
+}
\ No newline at end of file
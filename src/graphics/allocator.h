@@ -0,0 +1,108 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gfx {
+
+// Range of a memory block bound to a buffer or an image
+struct Allocation {
+	VkDeviceMemory memory = nullptr;
+	VkDeviceSize offset = 0u, size = 0u;
+	void* mapped = nullptr; // Address of the range when the memory is host visible, blocks stay mapped
+	uint32_t pool = 0u, block = 0u;
+
+	inline explicit operator bool() const { return memory; }
+};
+
+// Memory used through the allocator in a memory type
+struct MemoryStats {
+	uint32_t memoryType;
+	VkMemoryPropertyFlags properties;
+	uint32_t blocks = 0u, allocations = 0u;
+	VkDeviceSize reserved = 0u, used = 0u, largestFree = 0u;
+
+	// 0 when the free memory is a single range, close to 1 when it is split in many small ranges
+	inline double fragmentation() const {
+		return reserved > used ? 1. - double(largestFree) / double(reserved - used) : 0.;
+	}
+};
+
+// Best fit allocator of ranges in [0, size()). Free ranges are indexed by offset to merge a freed range with its
+// neighbours and by size for a best fit.
+class RangeAllocator {
+public:
+	// Make [size(), size) free
+	void grow(VkDeviceSize size);
+	// Alignment is a power of two
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+	void release(VkDeviceSize offset, VkDeviceSize size);
+
+	inline VkDeviceSize size() const { return capacity; }
+	inline VkDeviceSize used() const { return usedSize; }
+	inline uint32_t allocations() const { return count; }
+	inline VkDeviceSize largestFree() const { return freeBySize.empty() ? 0u : freeBySize.rbegin()->first; }
+
+private:
+	void insertFree(VkDeviceSize begin, VkDeviceSize end);
+	void eraseFree(std::map<VkDeviceSize, VkDeviceSize>::iterator it);
+
+	VkDeviceSize capacity = 0u, usedSize = 0u;
+	uint32_t count = 0u;
+	std::map<VkDeviceSize, VkDeviceSize> freeByOffset;
+	std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;
+};
+
+// Sub-allocator carving buffers and images out of big blocks of device memory, so that the number of
+// vkAllocateMemory calls stays far under maxMemoryAllocationCount. Every memory type has two pools, one for
+// linear resources and one for optimal images, so that bufferImageGranularity never applies between neighbours.
+// Resources bigger than half a block get a dedicated block.
+class MemoryAllocator {
+public:
+	~MemoryAllocator() { clean(); }
+
+	void init(VkPhysicalDevice gpu, VkDevice device);
+	void clean();
+
+	Allocation allocate(const VkMemoryRequirements &requirements, uint32_t memoryType, bool linear);
+	void free(Allocation &allocation);
+
+	// Defragmentation: the sparsest blocks, whose allocations fit in the free memory of the other blocks of their pool,
+	// stop receiving allocations. Their owners move the resources flagged by isEvacuated() in new allocations
+	// then endDefragmentation() releases the blocks that are now empty.
+	// Returns the number of evacuated blocks.
+	uint32_t beginDefragmentation();
+	bool isEvacuated(const Allocation &allocation) const;
+	void endDefragmentation();
+
+	// Memory types with at least one block
+	std::vector<MemoryStats> stats() const;
+
+private:
+	struct Block : public RangeAllocator {
+		VkDeviceMemory memory;
+		void* mapped = nullptr;
+		bool dedicated, evacuated = false;
+	};
+	// Destroyed blocks leave a null slot so that the block ids of the allocations stay valid
+	using Pool = std::vector<std::unique_ptr<Block>>;
+
+	void destroyBlock(Pool &pool, uint32_t block);
+
+	VkDevice device = nullptr;
+	VkPhysicalDeviceMemoryProperties properties;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> blockSizes;
+	std::array<Pool, 2 * VK_MAX_MEMORY_TYPES> pools; // Pool 2*t+linear of the memory type t
+	mutable std::mutex mutex;
+};
+
+}
\ No newline at end of file
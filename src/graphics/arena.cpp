@@ -0,0 +1,98 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "arena.h"
+
+#include <algorithm>
+
+namespace gfx {
+
+// Vertices and indices of the first buffers, and their meshlets
+static constexpr VkDeviceSize MIN_CAPACITY = VkDeviceSize(1) << 16, MIN_MESHLETS = VkDeviceSize(1) << 10;
+
+void GeometryArena::init(const Device &device, StagingRing &staging, const std::array<VkDeviceSize, VertexLayout::BINDING_COUNT> &vertexSizes) {
+	clean();
+	this->device = &device;
+	this->staging = &staging;
+	this->vertexSizes = vertexSizes;
+	vertexRanges = {};
+	indexRanges = {};
+	meshletRanges = {};
+	grownToken = 0u;
+	++ generation;
+}
+
+void GeometryArena::clean() {
+	if(!device) return;
+	for(VertexBuffer &stream : streams) stream.clean();
+	indices.clean();
+	meshlets.clean();
+	device = nullptr;
+}
+
+// Replace buffer, holding `capacity` elements of `size` bytes, by a buffer of `newCapacity` elements with the same content
+template<typename B>
+static void growBuffer(const Device &device, StagingRing &staging, B &buffer, const VkDeviceSize size,
+		const VkDeviceSize capacity, const VkDeviceSize newCapacity) {
+	B bigger;
+	bigger.init(device, size * newCapacity, true);
+	if(capacity) {
+		staging.copy(buffer, bigger, size * capacity);
+		staging.release(std::move(buffer));
+	}
+	buffer = std::move(bigger);
+}
+
+GeometryArena::Range GeometryArena::allocate(const uint32_t vertexCount, const uint32_t indexCount, const uint32_t meshletCount) {
+	VkDeviceSize firstVertex = 0u, firstIndex = 0u, firstMeshlet = 0u;
+	if(vertexCount && !vertexRanges.allocate(vertexCount, 1u, firstVertex)) {
+		const VkDeviceSize capacity = vertexRanges.size();
+		const VkDeviceSize newCapacity = std::max({ 2u * capacity, capacity + vertexCount, MIN_CAPACITY });
+		for(std::size_t i = 0; i < streams.size(); ++i)
+			growBuffer(*device, *staging, streams[i], vertexSizes[i], capacity, newCapacity);
+		vertexRanges.grow(newCapacity);
+		vertexRanges.allocate(vertexCount, 1u, firstVertex);
+		grownToken = staging->currentToken();
+	}
+	if(indexCount && !indexRanges.allocate(indexCount, 1u, firstIndex)) {
+		const VkDeviceSize capacity = indexRanges.size();
+		const VkDeviceSize newCapacity = std::max({ 2u * capacity, capacity + indexCount, MIN_CAPACITY });
+		growBuffer(*device, *staging, indices, sizeof(uint32_t), capacity, newCapacity);
+		indexRanges.grow(newCapacity);
+		indexRanges.allocate(indexCount, 1u, firstIndex);
+		grownToken = staging->currentToken();
+	}
+	if(meshletCount && !meshletRanges.allocate(meshletCount, 1u, firstMeshlet)) {
+		const VkDeviceSize capacity = meshletRanges.size();
+		const VkDeviceSize newCapacity = std::max({ 2u * capacity, capacity + meshletCount, MIN_MESHLETS });
+		growBuffer(*device, *staging, meshlets, sizeof(Meshlet), capacity, newCapacity);
+		meshletRanges.grow(newCapacity);
+		meshletRanges.allocate(meshletCount, 1u, firstMeshlet);
+		grownToken = staging->currentToken();
+		++ generation;
+	}
+	return { uint32_t(firstVertex), vertexCount, uint32_t(firstIndex), indexCount, uint32_t(firstMeshlet), meshletCount };
+}
+
+void GeometryArena::free(Range &range) {
+	if(!range) return;
+	if(range.vertexCount) vertexRanges.release(range.firstVertex, range.vertexCount);
+	indexRanges.release(range.firstIndex, range.indexCount);
+	if(range.meshletCount) meshletRanges.release(range.firstMeshlet, range.meshletCount);
+	range = {};
+}
+
+void GeometryArena::relocate() {
+	for(VertexBuffer &stream : streams) stream.relocate();
+	indices.relocate();
+	if(meshlets.relocate()) ++ generation;
+}
+
+VkDeviceSize GeometryArena::memory(const Range &range) const {
+	VkDeviceSize size = sizeof(uint32_t) * range.indexCount + sizeof(Meshlet) * range.meshletCount;
+	for(const VkDeviceSize vertexSize : vertexSizes) size += vertexSize * range.vertexCount;
+	return size;
+}
+
+}
\ No newline at end of file
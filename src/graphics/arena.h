@@ -0,0 +1,78 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "allocator.h"
+#include "staging.h"
+#include "vertexbuffer.h"
+
+#include <geometry/meshlets.h>
+
+namespace gfx {
+
+// Vertex streams and index buffer shared by many meshes, so that their draws need a single bind of the buffers.
+// A mesh gets a range of vertices, at the same place in every stream, and a range of indices relative to its first vertex.
+// The buffers are shared with the transfer queue, uploads to new ranges need no hand over while the others are drawn.
+// They grow by doubling, the content being copied by the staging ring. The meshlets of the meshes, read by the culling
+// pass, are in a storage buffer with a range per mesh, their indices being relative to the first index of the mesh.
+class GeometryArena {
+public:
+	struct Range {
+		uint32_t firstVertex = 0u, vertexCount = 0u, firstIndex = 0u, indexCount = 0u, firstMeshlet = 0u, meshletCount = 0u;
+
+		inline explicit operator bool() const { return indexCount; }
+	};
+
+	~GeometryArena() { clean(); }
+
+	// vertexSizes are the strides of the streams
+	void init(const Device &device, StagingRing &staging, const std::array<VkDeviceSize, VertexLayout::BINDING_COUNT> &vertexSizes);
+	void clean();
+
+	// Counts may be 0 but the one of the indices, the empty parts take no room. A range without vertices indexes the
+	// ones of another range, like the levels of detail appended to a mesh.
+	Range allocate(uint32_t vertexCount, uint32_t indexCount, uint32_t meshletCount);
+	// The draws using range must be done
+	void free(Range &range);
+
+	// Staging memory of the values of range in a stream, or of its indices
+	inline void* stageVertices(const Range &range, uint32_t stream) {
+		return staging->stage(streams[stream], vertexSizes[stream] * range.vertexCount, vertexSizes[stream] * range.firstVertex);
+	}
+	inline void* stageIndices(const Range &range) {
+		return staging->stage(indices, sizeof(uint32_t) * range.indexCount, sizeof(uint32_t) * range.firstIndex);
+	}
+	inline Meshlet* stageMeshlets(const Range &range) {
+		return static_cast<Meshlet*>(staging->stage(meshlets, sizeof(Meshlet) * range.meshletCount, sizeof(Meshlet) * range.firstMeshlet));
+	}
+
+	// Move the buffers evacuated by the memory allocator, the GPU must be idle
+	void relocate();
+
+	inline const std::array<VertexBuffer, VertexLayout::BINDING_COUNT>& getVertexBuffers() const { return streams; }
+	inline const IndexBuffer& getIndexBuffer() const { return indices; }
+	inline const StorageBuffer& getMeshletBuffer() const { return meshlets; }
+	// Meshlets allocated so far, the ranges are below
+	inline uint32_t meshletCapacity() const { return (uint32_t) meshletRanges.size(); }
+	// Changes whenever the meshlet buffer is replaced, so that the descriptor sets using it are updated
+	inline uint64_t meshletGeneration() const { return generation; }
+	// Batch copying the content of the last growth, draws from the arena wait for it
+	inline UploadToken grown() const { return grownToken; }
+	// Bytes of the buffers used by range
+	VkDeviceSize memory(const Range &range) const;
+
+private:
+	const Device *device = nullptr;
+	StagingRing *staging;
+	std::array<VkDeviceSize, VertexLayout::BINDING_COUNT> vertexSizes;
+	std::array<VertexBuffer, VertexLayout::BINDING_COUNT> streams;
+	IndexBuffer indices;
+	StorageBuffer meshlets;
+	RangeAllocator vertexRanges, indexRanges, meshletRanges;
+	UploadToken grownToken = 0u;
+	uint64_t generation = 0u;
+};
+
+}
\ No newline at end of file
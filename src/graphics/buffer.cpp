@@ -5,38 +5,54 @@
 
 namespace gfx {
 
-void Buffer::init(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+void Buffer::init(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, bool shared) {
 	clean();
 	
-	// Create buffer
+	// Create buffer, sharing is only concurrent between distinct families
+	const QueueFamilies &families = device.getQueueFamilies();
+	const uint32_t familyIds[] { families.graphicsId, families.transferId };
+	shared = shared && familyIds[0] != familyIds[1];
 	VkBufferCreateInfo bufferInfo {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0u,
 		.size = size,
 		.usage = usage,
-		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-		.queueFamilyIndexCount = 0u,
-		.pQueueFamilyIndices = nullptr
+		.sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = shared ? 2u : 0u,
+		.pQueueFamilyIndices = shared ? familyIds : nullptr
 	};
-	if(vkCreateBuffer(this->device = device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+	if(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
 		THROW_ERROR("failed to create buffer!");
+	this->device = &device;
+	this->size = size;
+	this->usage = usage;
+	this->properties = properties;
+	this->shared = shared;
 
 	// Memory allocation
-	if(device.allocateMemory<vkGetBufferMemoryRequirements>(buffer, properties, memory) != VK_SUCCESS)
-		THROW_ERROR("failed to allocate buffer memory!");
-	vkBindBufferMemory(device, buffer, memory, 0u);
+	allocation = device.allocateMemory<vkGetBufferMemoryRequirements>(buffer, properties, true);
+	vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
 }
 
 void Buffer::clean() {
 	if(!buffer) return;
-	vkDestroyBuffer(device, buffer, nullptr);
-	vkFreeMemory(device, memory, nullptr);
+	vkDestroyBuffer(*device, buffer, nullptr);
+	device->freeMemory(allocation);
 	buffer = nullptr;
 }
 
-void Buffer::copy(const Device &device, const Buffer &src, Buffer &dst, VkDeviceSize size) {
-	device.createCommandBuffer().beginOT().copyBuffer(src, dst, size).end().submitOT(device, device.getGraphicsQueue());
+bool Buffer::relocate() {
+	constexpr VkBufferUsageFlags copyUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if(!buffer || (usage & copyUsage) != copyUsage || !device->getAllocator().isEvacuated(allocation)) return false;
+	Buffer moved(*device, size, usage, properties, shared);
+	copy(*device, *this, moved, size);
+	*this = std::move(moved);
+	return true;
+}
+
+void Buffer::copy(const Device &device, const Buffer &src, Buffer &dst, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
+	device.createCommandBuffer().beginOT().copyBuffer(src, dst, size, srcOffset, dstOffset).end().submitOT(device, device.getGraphicsQueue());
 }
 
 }
\ No newline at end of file
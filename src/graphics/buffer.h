@@ -7,32 +7,55 @@
 #include "device.h"
 
 #include <cstring>
+#include <utility>
 
 namespace gfx {
 
 class Buffer {
 public:
 	Buffer() = default;
-	Buffer(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
-		init(device, size, usage, properties);
+	Buffer(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, bool shared = false) {
+		init(device, size, usage, properties, shared);
 	}
+	Buffer(const Buffer&) = delete;
+	Buffer(Buffer &&other) { *this = std::move(other); }
 	~Buffer() { clean(); }
 
-	void init(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+	Buffer& operator=(Buffer &&other) {
+		clean();
+		buffer = other.buffer;
+		allocation = other.allocation;
+		size = other.size;
+		usage = other.usage;
+		properties = other.properties;
+		shared = other.shared;
+		device = other.device;
+		other.buffer = nullptr;
+		other.allocation = {};
+		return *this;
+	}
+
+	// A shared buffer is used concurrently by the graphics and transfer families, without ownership transfers.
+	// Queues then only need semaphores between their accesses to the same ranges.
+	void init(const Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, bool shared = false);
 	void clean();
 
-	inline void* mapMemory(VkDeviceSize size = VK_WHOLE_SIZE) {
-		void* data;
-		vkMapMemory(device, memory, 0u, size, 0u, &data);
-		return data;
-	}
-	inline void unmapMemory() { vkUnmapMemory(device, memory); }
+	inline bool isShared() const { return shared; }
+
+	// Host visible buffers stay mapped in their memory block
+	inline void* mapMemory() { return allocation.mapped; }
+	inline void unmapMemory() {}
 	inline void fillWithData(const void* data, VkDeviceSize size) {
-		memcpy(mapMemory(size), data, (size_t) size);
+		memcpy(mapMemory(), data, (size_t) size);
 		unmapMemory();
 	}
 
-	static void copy(const Device &device, const Buffer &src, Buffer &dst, VkDeviceSize size);
+	// Move the content in a new allocation if the memory allocator evacuates the block of the current one.
+	// The VkBuffer changes, so its descriptors and command buffers must be updated when it returns true.
+	bool relocate();
+
+	static void copy(const Device &device, const Buffer &src, Buffer &dst, VkDeviceSize size,
+					VkDeviceSize srcOffset = 0u, VkDeviceSize dstOffset = 0u);
 
 	inline static Buffer createStagingBuffer(const Device &device, VkDeviceSize size) {
 		return Buffer(
@@ -52,9 +75,13 @@ public:
 
 private:
 	VkBuffer buffer = nullptr;
-	VkDeviceMemory memory;
+	Allocation allocation;
+	VkDeviceSize size;
+	VkBufferUsageFlags usage;
+	VkMemoryPropertyFlags properties;
+	bool shared = false;
 
-	VkDevice device;
+	const Device *device;
 };
 
 }
\ No newline at end of file
@@ -10,6 +10,10 @@
 #include "vertexbuffer.h"
 #include "sync.h"
 
+#include <initializer_list>
+#include <span>
+#include <vector>
+
 namespace gfx {
 
 class CommandBuffer {
@@ -45,7 +49,8 @@ public:
 		return *this;
 	}
 
-	CommandBuffer& beginRenderPass(const RenderPass &renderPass, const Swapchain &swapchain, const std::size_t frame) {
+	// A resumed pass keeps the attachments of the previous pass of the frame
+	CommandBuffer& beginRenderPass(const RenderPass &renderPass, const Swapchain &swapchain, const std::size_t frame, const bool resume = false) {
 		constexpr const VkClearValue clearValues[] = {
 			{.color={.float32={1.f, 1.f, 1.f, 1.f}}},
 			{.depthStencil={1.f, 0u}}
@@ -53,7 +58,7 @@ public:
 		VkRenderPassBeginInfo renderPassInfo {
 			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 			.pNext = nullptr,
-			.renderPass = renderPass,
+			.renderPass = resume ? renderPass.resumed() : (VkRenderPass) renderPass,
 			.framebuffer = renderPass.framebuffer(frame),
 			.renderArea = {
 				.offset = {0, 0},
@@ -88,10 +93,16 @@ public:
 
 	inline CommandBuffer& bindPipeline(const Pipeline &pipeline) { vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline); return *this; }
 
-	inline CommandBuffer& bindVertexBuffer(const VertexBuffer &vertexBuffer) {
-		const VkBuffer buffer = vertexBuffer;
-		const VkDeviceSize offset = 0u;
-		vkCmdBindVertexBuffers(cmd, 0u, 1u, &buffer, &offset);
+	// Bind the streams of a VertexDescription, vertexBuffers[i] to the binding i
+	template<std::size_t N>
+	inline CommandBuffer& bindVertexBuffers(const std::array<VertexBuffer, N> &vertexBuffers) {
+		VkBuffer buffers[N];
+		VkDeviceSize offsets[N];
+		for(std::size_t i = 0; i < N; ++i) {
+			buffers[i] = vertexBuffers[i];
+			offsets[i] = 0u;
+		}
+		vkCmdBindVertexBuffers(cmd, 0u, N, buffers, offsets);
 		return *this;
 	}
 
@@ -99,23 +110,59 @@ public:
 		vkCmdBindIndexBuffer(cmd, indexBuffer, 0u, VK_INDEX_TYPE_UINT32); return *this;
 	}
 
-	inline CommandBuffer& bindDescriptorSet(const Pipeline &pipeline, VkDescriptorSet set) {
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.getLayout(), 0u, 1u, &set, 0u, nullptr);
+	inline CommandBuffer& bindDescriptorSet(const Pipeline &pipeline, VkDescriptorSet set, uint32_t setIndex = 0u) {
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.getLayout(), setIndex, 1u, &set, 0u, nullptr);
+		return *this;
+	}
+
+	// Push constants of the shaders of pipeline
+	inline CommandBuffer& pushConstants(const Pipeline &pipeline, uint32_t size, const void* data) {
+		vkCmdPushConstants(cmd, pipeline.getLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0u, size, data); return *this;
+	}
+
+	inline CommandBuffer& bindPipeline(const ComputePipeline &pipeline) { vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline); return *this; }
+
+	inline CommandBuffer& bindDescriptorSet(const ComputePipeline &pipeline, VkDescriptorSet set, uint32_t setIndex = 0u) {
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getLayout(), setIndex, 1u, &set, 0u, nullptr);
 		return *this;
 	}
 
+	inline CommandBuffer& pushConstants(const ComputePipeline &pipeline, uint32_t size, const void* data) {
+		vkCmdPushConstants(cmd, pipeline.getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0u, size, data); return *this;
+	}
+
+	inline CommandBuffer& dispatch(uint32_t groupCountX, uint32_t groupCountY = 1u, uint32_t groupCountZ = 1u) {
+		vkCmdDispatch(cmd, groupCountX, groupCountY, groupCountZ); return *this;
+	}
+
 	inline CommandBuffer& draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
 		vkCmdDraw(cmd, vertexCount, instanceCount, firstVertex, firstInstance); return *this;
 	}
 
-	inline CommandBuffer& drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
-		vkCmdDrawIndexed(cmd, indexCount, instanceCount, firstVertex, 0, firstInstance); return *this;
+	inline CommandBuffer& drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t firstInstance,
+			int32_t vertexOffset = 0) {
+		vkCmdDrawIndexed(cmd, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance); return *this;
 	}
 
-	inline CommandBuffer& copyBuffer(const Buffer &src, Buffer &dst, VkDeviceSize size) {
+	// VkDrawIndexedIndirectCommand array of buffer at offset, one indirect draw per command without multiDraw
+	inline CommandBuffer& drawIndexedIndirect(const Buffer &buffer, VkDeviceSize offset, uint32_t count, bool multiDraw) {
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		if(multiDraw) vkCmdDrawIndexedIndirect(cmd, buffer, offset, count, stride);
+		else for(uint32_t i = 0; i < count; ++i) vkCmdDrawIndexedIndirect(cmd, buffer, offset + i * stride, 1u, stride);
+		return *this;
+	}
+
+	// Up to maxCount commands of buffer at offset, the number drawn is the uint32_t of countBuffer at countOffset
+	inline CommandBuffer& drawIndexedIndirectCount(const Buffer &buffer, VkDeviceSize offset,
+			const Buffer &countBuffer, VkDeviceSize countOffset, uint32_t maxCount) {
+		vkCmdDrawIndexedIndirectCount(cmd, buffer, offset, countBuffer, countOffset, maxCount, sizeof(VkDrawIndexedIndirectCommand));
+		return *this;
+	}
+
+	inline CommandBuffer& copyBuffer(const Buffer &src, Buffer &dst, VkDeviceSize size, VkDeviceSize srcOffset = 0u, VkDeviceSize dstOffset = 0u) {
 		const VkBufferCopy region {
-			.srcOffset = 0u,
-			.dstOffset = 0u,
+			.srcOffset = srcOffset,
+			.dstOffset = dstOffset,
 			.size = size
 		};
 		vkCmdCopyBuffer(cmd, src, dst, 1u, &region);
@@ -127,24 +174,69 @@ public:
 		return *this;
 	}
 
-	inline CommandBuffer& bufferBarrier(const Buffer &buffer, VkDeviceSize offset, VkDeviceSize size) {
-		const VkBufferMemoryBarrier barrier {
+	// Set `size` bytes of buffer from offset to the repeated 4 bytes value data, size is a multiple of 4 or VK_WHOLE_SIZE
+	inline CommandBuffer& fillBuffer(Buffer &buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data) {
+		vkCmdFillBuffer(cmd, buffer, offset, size, data);
+		return *this;
+	}
+
+	// Make the writes of srcAccess in srcStage visible to the accesses dstAccess of dstStage, on every resource
+	inline CommandBuffer& memoryBarrier(VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+		const VkMemoryBarrier barrier {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = srcAccess,
+			.dstAccessMask = dstAccess
+		};
+		vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0u, 1u, &barrier, 0u, nullptr, 0u, nullptr);
+		return *this;
+	}
+
+	// Queue family ownership transfer of whole buffers from srcFamily to dstFamily. It is recorded with the same
+	// families as a release by the source queue then as an acquire by the destination queue, which ignore the access
+	// masks of the other queue.
+	CommandBuffer& ownershipBarrier(std::span<const VkBuffer> buffers, uint32_t srcFamily, uint32_t dstFamily,
+			VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+		if(buffers.empty()) return *this;
+		std::vector<VkBufferMemoryBarrier> barriers(buffers.size());
+		for(std::size_t i = 0; i < buffers.size(); ++i) barriers[i] = {
 			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 			.pNext = nullptr,
-			.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT,
+			.srcAccessMask = srcAccess,
+			.dstAccessMask = dstAccess,
+			.srcQueueFamilyIndex = srcFamily,
+			.dstQueueFamilyIndex = dstFamily,
+			.buffer = buffers[i],
+			.offset = 0u,
+			.size = VK_WHOLE_SIZE
+		};
+		vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0u, 0u, nullptr, (uint32_t) barriers.size(), barriers.data(), 0u, nullptr);
+		return *this;
+	}
+
+	// Make the writes of srcAccess in srcStage visible to the accesses dstAccess of dstStage on every level of image,
+	// moving it from oldLayout to newLayout
+	CommandBuffer& layoutBarrier(VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+		const VkImageMemoryBarrier barrier {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = srcAccess,
+			.dstAccessMask = dstAccess,
+			.oldLayout = oldLayout,
+			.newLayout = newLayout,
 			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
 			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.buffer = buffer,
-			.offset = offset,
-			.size = size
+			.image = image,
+			.subresourceRange = {
+				.aspectMask = aspect,
+				.baseMipLevel = 0u,
+				.levelCount = VK_REMAINING_MIP_LEVELS,
+				.baseArrayLayer = 0u,
+				.layerCount = 1u
+			}
 		};
-		vkCmdPipelineBarrier(cmd,
-			VK_PIPELINE_STAGE_HOST_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			0u, 0u, nullptr,
-			1u, &barrier,
-			0u, nullptr);
+		vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0u, 0u, nullptr, 0u, nullptr, 1u, &barrier);
 		return *this;
 	}
 
@@ -209,6 +301,45 @@ public:
 			THROW_ERROR("failed to submit draw command buffer!");
 	}
 
+	// Submit waiting for and signaling binary and timeline semaphores, the values of timeline semaphores are ignored
+	// for the binary ones
+	static void submit(const Device &device, const CommandBuffer *cmds, uint32_t count, VkQueue queue,
+			std::initializer_list<SemaphoreSubmit> waits, std::initializer_list<SemaphoreSubmit> signals, VkFence fence = nullptr) {
+		std::vector<VkSemaphore> waitSemaphores, signalSemaphores;
+		std::vector<uint64_t> waitValues, signalValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+		for(const SemaphoreSubmit &w : waits) if(w.semaphore) {
+			waitSemaphores.push_back(w.semaphore);
+			waitValues.push_back(w.value);
+			waitStages.push_back(w.stage);
+		}
+		for(const SemaphoreSubmit &s : signals) if(s.semaphore) {
+			signalSemaphores.push_back(s.semaphore);
+			signalValues.push_back(s.value);
+		}
+		const VkTimelineSemaphoreSubmitInfo timelineInfo {
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreValueCount = (uint32_t) waitValues.size(),
+			.pWaitSemaphoreValues = waitValues.data(),
+			.signalSemaphoreValueCount = (uint32_t) signalValues.size(),
+			.pSignalSemaphoreValues = signalValues.data()
+		};
+		const VkSubmitInfo submitInfo {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = device.hasTimelineSemaphores() ? &timelineInfo : nullptr,
+			.waitSemaphoreCount = (uint32_t) waitSemaphores.size(),
+			.pWaitSemaphores = waitSemaphores.data(),
+			.pWaitDstStageMask = waitStages.data(),
+			.commandBufferCount = count,
+			.pCommandBuffers = reinterpret_cast<const VkCommandBuffer*>(cmds),
+			.signalSemaphoreCount = (uint32_t) signalSemaphores.size(),
+			.pSignalSemaphores = signalSemaphores.data()
+		};
+		if(vkQueueSubmit(queue, 1u, &submitInfo, fence) != VK_SUCCESS)
+			THROW_ERROR("failed to submit command buffers!");
+	}
+
 	inline void submit(VkQueue queue, Semaphore &wait, Semaphore &signal, Fence &fence) {
 		submit(this, 1, queue, wait, signal, fence);
 	}
@@ -70,9 +70,8 @@ void DescriptorPool::init(const Device &device, uint32_t size) {
 			uniformBufferCount += bindings[i].descriptorCount;
 		}
 	if(uniformBufferSize) {
-		uniformBuffer.init(device, size * uniformBufferSize,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		uniformBuffer.init(device, size * uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	}
 	
 	// Update descriptor sets
@@ -113,4 +112,77 @@ void DescriptorPool::clean() {
 	pool = nullptr;
 }
 
+void StorageLayout::init(const Device &device, const uint32_t count, const VkShaderStageFlags shaderStage) {
+	clean();
+	std::vector<VkDescriptorSetLayoutBinding> bindings(count);
+	for(uint32_t i = 0; i < count; ++i)
+		bindings[i] = { i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1u, shaderStage, nullptr };
+	const VkDescriptorSetLayoutCreateInfo layoutInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.bindingCount = count,
+		.pBindings = bindings.data()
+	};
+	if(vkCreateDescriptorSetLayout(this->device = device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		THROW_ERROR("failed to create storage set layout!");
+	this->count = count;
+}
+
+void StorageLayout::clean() {
+	if(!layout) return;
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	layout = nullptr;
+}
+
+void StorageSet::init(const Device &device, const StorageLayout &layout, const VkBuffer* buffers) {
+	clean();
+	const VkDescriptorPoolSize poolSize { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, layout.size() };
+	const VkDescriptorPoolCreateInfo poolInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.maxSets = 1u,
+		.poolSizeCount = 1u,
+		.pPoolSizes = &poolSize
+	};
+	if(vkCreateDescriptorPool(this->device = device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		THROW_ERROR("failed to create storage descriptor pool!");
+	const VkDescriptorSetAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = pool,
+		.descriptorSetCount = 1u,
+		.pSetLayouts = &layout.getLayout()
+	};
+	if(vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		THROW_ERROR("failed to allocate storage descriptor set!");
+
+	std::vector<VkDescriptorBufferInfo> bufferInfos(layout.size());
+	std::vector<VkWriteDescriptorSet> writes(layout.size());
+	for(uint32_t i = 0; i < layout.size(); ++i) {
+		bufferInfos[i] = { buffers[i], 0u, VK_WHOLE_SIZE };
+		writes[i] = VkWriteDescriptorSet {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = set,
+			.dstBinding = i,
+			.dstArrayElement = 0u,
+			.descriptorCount = 1u,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = nullptr,
+			.pBufferInfo = &bufferInfos[i],
+			.pTexelBufferView = nullptr
+		};
+	}
+	vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0u, nullptr);
+}
+
+void StorageSet::clean() {
+	if(!pool) return;
+	// Destroying the pool frees its set
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	pool = nullptr;
+}
+
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 namespace gfx {
 
+// One descriptor set per frame in flight. Their uniform buffers are slices of a persistently mapped host coherent buffer,
+// the host writes the slices of a frame once the previous submit of the frame is done.
 class DescriptorPool {
 public:
 	~DescriptorPool() { clean(); }
@@ -25,6 +27,10 @@ public:
 	inline VkDeviceSize getOffset(uint32_t set, uint32_t binding, uint32_t arrayElement = 0u) {
 		return set * uniformBufferSize + bufferRanges[binding].offset + arrayElement * bufferRanges[binding].storage;
 	}
+	// Write the uniform buffer of a binding of the set, the next submits see it without any barrier
+	inline void updateUniform(uint32_t set, uint32_t binding, const void* data, VkDeviceSize size, uint32_t arrayElement = 0u) {
+		memcpy(static_cast<char*>(uniformBuffer.mapMemory()) + getOffset(set, binding, arrayElement), data, (size_t) size);
+	}
 
 	inline const VkDescriptorSet& operator[](std::size_t i) const { return sets[i]; }
 
@@ -51,4 +57,52 @@ private:
 	}
 };
 
+// Layout of the descriptor sets made of `count` storage buffers at the bindings 0, ..., count-1
+class StorageLayout {
+public:
+	~StorageLayout() { clean(); }
+
+	void init(const Device &device, uint32_t count, VkShaderStageFlags shaderStage);
+	void clean();
+
+	inline operator VkDescriptorSetLayout() const { return layout; }
+	inline const VkDescriptorSetLayout& getLayout() const { return layout; }
+	inline uint32_t size() const { return count; }
+
+private:
+	VkDescriptorSetLayout layout = nullptr;
+	uint32_t count;
+	VkDevice device;
+};
+
+// Descriptor set of a StorageLayout with its own pool, so that each object owns the set of its buffers
+class StorageSet {
+public:
+	StorageSet() = default;
+	StorageSet(const StorageSet&) = delete;
+	StorageSet(StorageSet &&other) { *this = std::move(other); }
+	~StorageSet() { clean(); }
+
+	StorageSet& operator=(StorageSet &&other) {
+		clean();
+		pool = other.pool;
+		set = other.set;
+		device = other.device;
+		other.pool = nullptr;
+		return *this;
+	}
+
+	// Allocate the set and bind the whole buffers[i] at the binding i
+	void init(const Device &device, const StorageLayout &layout, const VkBuffer* buffers);
+	void clean();
+
+	inline operator VkDescriptorSet() const { return set; }
+	inline explicit operator bool() const { return pool; }
+
+private:
+	VkDescriptorPool pool = nullptr;
+	VkDescriptorSet set;
+	VkDevice device;
+};
+
 }
\ No newline at end of file
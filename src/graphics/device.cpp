@@ -4,9 +4,12 @@
 #include "debug.h"
 
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <cstdint>
+#include <fstream>
 #include <limits>
+#include <string>
 #include <vector>
 
 namespace gfx {
@@ -21,19 +24,70 @@ static QueueFamilies findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR sur
 	const std::vector<VkQueueFamilyProperties> queueFamilies = vkGetList(vkGetPhysicalDeviceQueueFamilyProperties, device);
 
 	QueueFamilies indices;
+	// Compute passes are recorded on the graphics queue, Vulkan guarantees a family supporting both
+	constexpr VkQueueFlags graphicsCompute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
 	for(uint32_t i = 0; i < (uint32_t) queueFamilies.size(); ++i) {
-		if(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsId = i;
+		if((queueFamilies[i].queueFlags & graphicsCompute) == graphicsCompute) indices.graphicsId = i;
 		VkBool32 surfaceSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &surfaceSupport);
 		if(surfaceSupport) {
 			indices.presentId = i;
-			if(indices.presentId == indices.graphicsId) return indices;
+			if(indices.presentId == indices.graphicsId) break;
 		}
 	}
 
+	// Transfer only families are the copy engines of the GPU, running beside rendering
+	indices.transferId = indices.graphicsId;
+	for(uint32_t i = 0; i < (uint32_t) queueFamilies.size(); ++i)
+		if((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & graphicsCompute)) {
+			indices.transferId = i;
+			break;
+		}
+
 	return indices;
 }
 
+// Features of Vulkan 1.2 used when available: timeline semaphores synchronize the transfer queue with rendering and
+// indirect draws with a count written by the GPU draw the clusters left by culling
+static VkPhysicalDeviceVulkan12Features vulkan12Support(VkPhysicalDevice gpu) {
+	VkPhysicalDeviceVulkan12Features vulkan12 {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = nullptr
+	};
+	if(Device::getProperties(gpu).apiVersion < VK_API_VERSION_1_2) return vulkan12;
+	VkPhysicalDeviceFeatures2 features {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &vulkan12
+	};
+	vkGetPhysicalDeviceFeatures2(gpu, &features);
+	return vulkan12;
+}
+
+// Pipeline cache of a GPU, next to visu.ini. The file name holds the ids of the GPU and the cache UUID of its driver,
+// so that every GPU keeps its own cache and a driver update starts a new one.
+static std::string pipelineCachePath(const VkPhysicalDeviceProperties &properties) {
+	char key[2 * VK_UUID_SIZE + 16];
+	int n = std::snprintf(key, sizeof(key), "%04x-%04x-", properties.vendorID, properties.deviceID);
+	for(const uint8_t byte : properties.pipelineCacheUUID) n += std::snprintf(key + n, sizeof(key) - n, "%02x", byte);
+	return std::string(BUILD_DIR "/pipelines-") + key + ".cache";
+}
+
+// Content of the cache file of the GPU, empty when it is missing or when its header was not written for this GPU
+static std::vector<char> readPipelineCache(const VkPhysicalDeviceProperties &properties) {
+	std::ifstream file(pipelineCachePath(properties), std::ios::ate | std::ios::binary);
+	if(file.fail()) return {};
+	std::vector<char> data((size_t) file.tellg());
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	// Header version one: header size, header version, vendor id, device id and pipeline cache UUID
+	uint32_t header[4];
+	if(file.fail() || data.size() < sizeof(header) + VK_UUID_SIZE) return {};
+	std::memcpy(header, data.data(), sizeof(header));
+	if(header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header[2] != properties.vendorID || header[3] != properties.deviceID
+		|| std::memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE)) return {};
+	return data;
+}
+
 static inline bool extensionAvailable(const std::vector<VkExtensionProperties> &properties, const char* extension) {
 	return std::ranges::find_if(properties, [&](const VkExtensionProperties &e) {
 		return !strcmp(e.extensionName, extension);
@@ -80,8 +134,12 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 
 	this->gpu = gpu;
 
-	// Choose queue families
+	// Choose queue families, uploads stay on the graphics queue when nothing can synchronize another one with rendering
 	queueFamilies = findQueueFamilies(gpu, window.getSurface());
+	const VkPhysicalDeviceVulkan12Features vulkan12 = vulkan12Support(gpu);
+	timelineSemaphores = vulkan12.timelineSemaphore;
+	drawIndirectCount = vulkan12.drawIndirectCount;
+	if(!timelineSemaphores) queueFamilies.transferId = queueFamilies.graphicsId;
 	std::vector<VkDeviceQueueCreateInfo> queueInfos;
 	float queuePriority = 1.f;
 	const auto addQ = [&](uint32_t i) {
@@ -96,6 +154,8 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 	};
 	addQ(queueFamilies.graphicsId);
 	if(queueFamilies.presentId != queueFamilies.graphicsId) addQ(queueFamilies.presentId);
+	if(queueFamilies.transferId != queueFamilies.graphicsId && queueFamilies.transferId != queueFamilies.presentId)
+		addQ(queueFamilies.transferId);
 
 	std::vector<const char*> extensions(RequiredExtensions, RequiredExtensions + std::size(RequiredExtensions));
 	#ifdef VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME
@@ -105,14 +165,24 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 	#endif
 
 	features = {};
-	// VkPhysicalDeviceFeatures deviceFeatures;
-	// vkGetPhysicalDeviceFeatures(gpu, &deviceFeatures);
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(gpu, &deviceFeatures);
 	// features.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// Indirect draws of the scene, drawn one command at a time without multiDrawIndirect
+	features.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+	features.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = nullptr,
+		.drawIndirectCount = drawIndirectCount,
+		.timelineSemaphore = timelineSemaphores
+	};
 
 	// Create logical device
 	VkDeviceCreateInfo deviceInfo {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.pNext = nullptr,
+		.pNext = timelineSemaphores || drawIndirectCount ? &vulkan12Features : nullptr,
 		.flags = 0u,
 		.queueCreateInfoCount = (uint32_t) queueInfos.size(),
 		.pQueueCreateInfos = queueInfos.data(),
@@ -132,8 +202,9 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 	// Get queues
 	vkGetDeviceQueue(device, queueFamilies.graphicsId, 0, &graphicsQueue);
 	vkGetDeviceQueue(device, queueFamilies.presentId, 0, &presentQueue);
+	vkGetDeviceQueue(device, queueFamilies.transferId, 0, &transferQueue);
 
-	// Create command pool
+	// Create command pools
 	VkCommandPoolCreateInfo poolInfo {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		.pNext = nullptr,
@@ -143,6 +214,9 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 
 	if(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
 		THROW_ERROR("failed to create command pool!");
+	poolInfo.queueFamilyIndex = queueFamilies.transferId;
+	if(vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+		THROW_ERROR("failed to create transfer command pool!");
 
 	// Create OT fence
 	const VkFenceCreateInfo fenceInfo {
@@ -152,22 +226,65 @@ void Device::init(const Window &window, VkPhysicalDevice gpu) {
 	};
 	if(vkCreateFence(this->device = device, &fenceInfo, nullptr, &OTFence) != VK_SUCCESS)
 		THROW_ERROR("failed to create OT fence!");
+
+	// Pipelines already compiled by a previous run skip their compilation
+	const std::vector<char> cacheData = readPipelineCache(getProperties());
+	const VkPipelineCacheCreateInfo cacheInfo {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.initialDataSize = cacheData.size(),
+		.pInitialData = cacheData.data()
+	};
+	if(vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+		THROW_ERROR("failed to create pipeline cache!");
+	loadedCacheSize = cacheData.size();
+
+	allocator.init(gpu, device);
 }
 
 void Device::clean() {
 	if(!device) return;
+	allocator.clean();
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 	vkDestroyFence(device, OTFence, nullptr);
+	vkDestroyCommandPool(device, transferCommandPool, nullptr);
 	vkDestroyCommandPool(device, commandPool, nullptr);
 	vkDestroyDevice(device, nullptr);
 	device = nullptr;
 }
 
+void Device::savePipelineCache() const {
+	size_t size;
+	if(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == loadedCacheSize) return;
+	std::vector<char> data(size);
+	if(vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+	std::ofstream file(pipelineCachePath(getProperties()), std::ios::binary);
+	file.write(data.data(), size);
+	if(file.fail()) DEBUG_MSG("Failed to write the pipeline cache");
+}
+
 CommandBuffer Device::createCommandBuffer(bool primary) const {
 	CommandBuffer cmdBuf;
 	allocCommandBuffers(&cmdBuf, 1u, primary);
 	return cmdBuf;
 }
 
+CommandBuffer Device::createTransferCommandBuffer() const {
+	const VkCommandBufferAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = transferCommandPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1u
+	};
+	CommandBuffer cmdBuf;
+	if(vkAllocateCommandBuffers(device, &allocInfo, reinterpret_cast<VkCommandBuffer*>(&cmdBuf)) != VK_SUCCESS)
+		THROW_ERROR("failed to allocate transfer command buffer!");
+	return cmdBuf;
+}
+
 void Device::allocCommandBuffers(CommandBuffer *cmdBufs, uint32_t size, bool primary) const {
 	const VkCommandBufferAllocateInfo allocInfo {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "allocator.h"
 #include "instance.h"
 #include "window.h"
 
@@ -15,6 +16,8 @@ struct QueueFamilies {
 	const static uint32_t NOT_AN_ID;
 	uint32_t graphicsId = NOT_AN_ID;
 	uint32_t presentId = NOT_AN_ID;
+	// Family of the uploads, a family without graphics nor compute when there is one, graphicsId otherwise
+	uint32_t transferId = NOT_AN_ID;
 	inline bool correct() const { return graphicsId != NOT_AN_ID && presentId != NOT_AN_ID; }
 	inline operator const uint32_t*() const { return reinterpret_cast<const uint32_t*>(this); }
 };
@@ -37,6 +40,11 @@ public:
 	inline void freeCommandBuffers(CommandBuffer *cmdBufs, uint32_t size) const {
 		if(device) vkFreeCommandBuffers(device, commandPool, size, reinterpret_cast<VkCommandBuffer*>(cmdBufs));
 	}
+	// Primary command buffers of the transfer queue
+	CommandBuffer createTransferCommandBuffer() const;
+	inline void freeTransferCommandBuffers(CommandBuffer *cmdBufs, uint32_t size) const {
+		if(device) vkFreeCommandBuffers(device, transferCommandPool, size, reinterpret_cast<VkCommandBuffer*>(cmdBufs));
+	}
 	const VkFence& getOTFence() const { return OTFence; }
 
 	inline void waitIdle() const { vkDeviceWaitIdle(device); }
@@ -44,7 +52,16 @@ public:
 	inline VkPhysicalDevice getGPU() const { return gpu; }
 	inline VkQueue getGraphicsQueue() const { return graphicsQueue; }
 	inline VkQueue getPresentQueue() const { return presentQueue; }
+	// The graphics queue when the device has no dedicated transfer family
+	inline VkQueue getTransferQueue() const { return transferQueue; }
+	inline bool hasTimelineSemaphores() const { return timelineSemaphores; }
+	// vkCmdDrawIndexedIndirectCount, core since Vulkan 1.2 but optional
+	inline bool hasDrawIndirectCount() const { return drawIndirectCount; }
+	// Optional features enabled when the GPU supports them
+	inline const VkPhysicalDeviceFeatures& getFeatures() const { return features; }
 	inline const QueueFamilies& getQueueFamilies() const { return queueFamilies; }
+	// Loaded from the file of the GPU and its driver at init, written back at clean when pipelines were added
+	inline VkPipelineCache getPipelineCache() const { return pipelineCache; }
 
 	inline std::vector<VkSurfaceFormatKHR> getSurfaceFormats(const Window &window) const {
 		return vkGetList(vkGetPhysicalDeviceSurfaceFormatsKHR, gpu, window.getSurface());
@@ -72,30 +89,35 @@ public:
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
 
+	// Sub-allocate the memory of a buffer or an image (linear is false for optimal images)
 	template<auto getRequirements>
-	VkResult allocateMemory(auto object, VkMemoryPropertyFlags properties, VkDeviceMemory &memory) const {
+	Allocation allocateMemory(auto object, VkMemoryPropertyFlags properties, bool linear) const {
 		VkMemoryRequirements memReq;
 		getRequirements(device, object, &memReq);
-		VkMemoryAllocateInfo allocInfo {
-			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-			.pNext = nullptr,
-			.allocationSize = memReq.size,
-			.memoryTypeIndex = findMemoryType(memReq.memoryTypeBits, properties)
-		};
-		return vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+		return allocator.allocate(memReq, findMemoryType(memReq.memoryTypeBits, properties), linear);
 	}
+	inline void freeMemory(Allocation &allocation) const { allocator.free(allocation); }
+	// The allocator is shared by every resource created with a const Device
+	inline MemoryAllocator& getAllocator() const { return allocator; }
 
 private:
 	VkPhysicalDevice gpu = nullptr;
 	VkDevice device = nullptr;
 
 	VkPhysicalDeviceFeatures features;
+	bool timelineSemaphores, drawIndirectCount;
 
 	QueueFamilies queueFamilies;
-	VkQueue graphicsQueue, presentQueue;
+	VkQueue graphicsQueue, presentQueue, transferQueue;
 
-	VkCommandPool commandPool;
+	VkCommandPool commandPool, transferCommandPool;
 	VkFence OTFence;
+
+	VkPipelineCache pipelineCache;
+	std::size_t loadedCacheSize;
+	void savePipelineCache() const;
+
+	mutable MemoryAllocator allocator;
 };
 
 }
\ No newline at end of file
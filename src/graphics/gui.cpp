@@ -129,7 +129,7 @@ void GUI::init(Instance &instance, const Device &device, const Swapchain &swapch
 		.ImageCount = (uint32_t) swapchain.size(),
 		.MSAASamples = VK_SAMPLE_COUNT_1_BIT,
 		// (Optional)
-		.PipelineCache = nullptr,
+		.PipelineCache = device.getPipelineCache(),
 		.Subpass = 0u,
 		// (Optional) Dynamic Rendering
 		// TODO: What is???
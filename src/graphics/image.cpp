@@ -4,7 +4,8 @@
 
 namespace gfx {
 
-void Image::init(const Device &device, VkExtent2D extent, VkImageTiling tiling, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties) {
+void Image::init(const Device &device, VkExtent2D extent, VkImageTiling tiling, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+		uint32_t mipLevels) {
 	clean();
 
 	const VkImageCreateInfo info {
@@ -18,7 +19,7 @@ void Image::init(const Device &device, VkExtent2D extent, VkImageTiling tiling,
 			.height = extent.height,
 			.depth = 1u
 		},
-		.mipLevels = 1u,
+		.mipLevels = mipLevels,
 		.arrayLayers = 1u,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = tiling,
@@ -28,22 +29,23 @@ void Image::init(const Device &device, VkExtent2D extent, VkImageTiling tiling,
 		.pQueueFamilyIndices = nullptr,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
 	};
-	if(vkCreateImage(this->device = device, &info, nullptr, &image) != VK_SUCCESS)
+	if(vkCreateImage(device, &info, nullptr, &image) != VK_SUCCESS)
 		THROW_ERROR("failed to create image!");
+	this->device = &device;
 	
-	if(device.allocateMemory<vkGetImageMemoryRequirements>(image, properties, memory) != VK_SUCCESS)
-		THROW_ERROR("failed to allocate image memory!");
-	vkBindImageMemory(device, image, memory, 0u);
+	allocation = device.allocateMemory<vkGetImageMemoryRequirements>(image, properties, tiling == VK_IMAGE_TILING_LINEAR);
+	vkBindImageMemory(device, image, allocation.memory, allocation.offset);
 }
 
 void Image::clean() {
 	if(!image) return;
-	vkFreeMemory(device, memory, nullptr);
-	vkDestroyImage(device, image, nullptr);
+	vkDestroyImage(*device, image, nullptr);
+	device->freeMemory(allocation);
 	image = nullptr;
 }
 
-VkImageView Image::createView(VkDevice device, VkImage image, int dim, VkFormat format, VkImageAspectFlags aspect, uint32_t levelCount) {
+VkImageView Image::createView(VkDevice device, VkImage image, int dim, VkFormat format, VkImageAspectFlags aspect, uint32_t levelCount,
+		uint32_t baseLevel) {
 	ASSERT(1 <= dim && dim <= 3);
 	static constexpr VkImageViewType viewTypes[] { VK_IMAGE_VIEW_TYPE_1D, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_VIEW_TYPE_3D };
 	const VkImageViewCreateInfo viewInfo {
@@ -61,7 +63,7 @@ VkImageView Image::createView(VkDevice device, VkImage image, int dim, VkFormat
 		},
 		.subresourceRange = {
 			.aspectMask = aspect,
-			.baseMipLevel = 0u,
+			.baseMipLevel = baseLevel,
 			.levelCount = levelCount,
 			.baseArrayLayer = 0u,
 			.layerCount = 1u
@@ -80,6 +82,7 @@ void DepthImage::init(const Device &device, VkExtent2D extent) {
 		const VkFormatProperties properties = device.getFormatProperties(f);
 		if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
 			format = f;
+			sampled = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
 			break;
 		}
 	}
@@ -92,13 +95,14 @@ void DepthImage::init(const Device &device, VkExtent2D extent) {
 void DepthImage::recreate(const Device &device, VkExtent2D extent) {
 	// TODO: Reallocation is certainly expensive find a new way to recreate the depth image.
 	clean();
-	Image::init(device, extent, VK_IMAGE_TILING_OPTIMAL, format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Image::init(device, extent, VK_IMAGE_TILING_OPTIMAL, format,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (sampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0u), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	view = createView(device, image, 2, format, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
 void DepthImage::clean() {
 	if(!image) return;
-	vkDestroyImageView(device, view, nullptr);
+	vkDestroyImageView(*device, view, nullptr);
 	Image::clean();
 }
 
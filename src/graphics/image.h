@@ -8,18 +8,20 @@ class Image {
 public:
 	~Image() { clean(); }
 
-	void init(const Device &device, VkExtent2D extent, VkImageTiling tiling, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
+	void init(const Device &device, VkExtent2D extent, VkImageTiling tiling, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+			uint32_t mipLevels = 1u);
 	void clean();
 
 	inline operator VkImage() const { return image; }
 
 	// TODO: used dim as a template? 
-	static VkImageView createView(VkDevice device, VkImage image, int dim, VkFormat format, VkImageAspectFlags aspect, uint32_t levelCount=1u);
+	static VkImageView createView(VkDevice device, VkImage image, int dim, VkFormat format, VkImageAspectFlags aspect, uint32_t levelCount=1u,
+			uint32_t baseLevel=0u);
 
 protected:
 	VkImage image = nullptr;
-	VkDeviceMemory memory;
-	VkDevice device;
+	Allocation allocation;
+	const Device *device;
 };
 
 class DepthImage : Image {
@@ -32,10 +34,14 @@ public:
 
 	VkFormat getFormat() const { return format; }
 	VkImageView getView() const { return view; }
+	VkImage getImage() const { return image; }
+	// Whether the depth can be read by the shaders once rendered, to build the depth pyramid
+	bool isSampled() const { return sampled; }
 
 private:
 	VkFormat format;
 	VkImageView view;
+	bool sampled;
 };
 
 }
@@ -36,7 +36,7 @@ void Instance::init(const char* name, const Extensions &requiredExtensions) {
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 		.pEngineName = "No Engine",
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0
+		.apiVersion = VK_API_VERSION_1_2 // Devices under 1.2 only miss the dedicated transfer queue
 	};
 
 	// Required extensions
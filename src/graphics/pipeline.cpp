@@ -5,7 +5,6 @@
 #include "pipeline.h"
 
 #include "debug.h"
-#include "vertexbuffer.h"
 #include "descriptor.h"
 
 #include <fstream>
@@ -16,17 +15,24 @@ Shader::Shader(const Device &device, const char* shaderPath) {
 	// Read file
 	std::ifstream file(shaderPath, std::ios::ate | std::ios::binary);
 	if(file.fail()) THROW_ERROR(std::string("Can't read file: ") + shaderPath);
-	std::vector<char> code((size_t) file.tellg());
+	std::vector<uint32_t> code((size_t) file.tellg() / sizeof(uint32_t));
 	file.seekg(0);
-	file.read(code.data(), code.size());
+	file.read(reinterpret_cast<char*>(code.data()), sizeof(uint32_t) * code.size());
 	file.close();
-	// Create shader
+	create(device, code);
+}
+
+Shader::Shader(const Device &device, const std::span<const uint32_t> code) {
+	create(device, code);
+}
+
+void Shader::create(const Device &device, const std::span<const uint32_t> code) {
 	VkShaderModuleCreateInfo shaderInfo {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0u,
-		.codeSize = code.size(),
-		.pCode = (const uint*) code.data()
+		.codeSize = code.size_bytes(),
+		.pCode = code.data()
 	};
 	if(vkCreateShaderModule(this->device = device, &shaderInfo, nullptr, &shader) != VK_SUCCESS)
 		THROW_ERROR("failed to create shader module!");
@@ -39,7 +45,10 @@ void Shader::clean() {
 }
 
 void Pipeline::init(const Device &device, const Shader &vertexShader, const Shader &fragmentShader,
-					const DescriptorPool &descriptorPool, const RenderPass &renderPass) {
+					const DescriptorPool &descriptorPool, const RenderPass &renderPass,
+					const VkPipelineVertexInputStateCreateInfo &vertexInput,
+					const VkSpecializationInfo *vertexConstants, const uint32_t pushConstantSize,
+					const VkDescriptorSetLayout objectLayout) {
 	clean();
 
 	// Create shader stages
@@ -53,21 +62,11 @@ void Pipeline::init(const Device &device, const Shader &vertexShader, const Shad
 	}
 	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
 	stages[0].module = vertexShader;
+	stages[0].pSpecializationInfo = vertexConstants;
 	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	stages[1].module = fragmentShader;
 		
 	// Input
-	const auto bindingDescription = Vertex::getBindingDescription();
-	const auto attributeDescriptions = Vertex::getAttributeDescription();
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.pNext = nullptr,
-		.flags = 0u,
-		.vertexBindingDescriptionCount = 1u,
-		.pVertexBindingDescriptions = &bindingDescription,
-		.vertexAttributeDescriptionCount = (uint) attributeDescriptions.size(),
-		.pVertexAttributeDescriptions = attributeDescriptions.data()
-	};
 	VkPipelineInputAssemblyStateCreateInfo assemblyInfo {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
 		.pNext = nullptr,
@@ -171,14 +170,20 @@ void Pipeline::init(const Device &device, const Shader &vertexShader, const Shad
 	};
 
 	// Layout
+	const VkPushConstantRange pushConstantRange {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0u,
+		.size = pushConstantSize
+	};
+	const VkDescriptorSetLayout setLayouts[] { descriptorPool.getLayout(), objectLayout };
 	const VkPipelineLayoutCreateInfo layoutInfo {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0u,
-		.setLayoutCount = 1u,
-		.pSetLayouts = &descriptorPool.getLayout(),
-		.pushConstantRangeCount = 0u,
-		.pPushConstantRanges = nullptr
+		.setLayoutCount = objectLayout ? 2u : 1u,
+		.pSetLayouts = setLayouts,
+		.pushConstantRangeCount = pushConstantSize ? 1u : 0u,
+		.pPushConstantRanges = &pushConstantRange
 	};
 
 	if(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
@@ -191,7 +196,7 @@ void Pipeline::init(const Device &device, const Shader &vertexShader, const Shad
 		.flags = 0u,
 		.stageCount = std::size(stages), // shader stages
 		.pStages = stages,
-		.pVertexInputState = &vertexInputInfo,
+		.pVertexInputState = &vertexInput,
 		.pInputAssemblyState = &assemblyInfo,
 		.pTessellationState = nullptr,
 		.pViewportState = &viewportInfo,
@@ -207,7 +212,7 @@ void Pipeline::init(const Device &device, const Shader &vertexShader, const Shad
 		.basePipelineIndex = -1
 	};
 
-	if(vkCreateGraphicsPipelines(this->device = device, VK_NULL_HANDLE, 1u, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	if(vkCreateGraphicsPipelines(this->device = device, device.getPipelineCache(), 1u, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
 		THROW_ERROR("failed to create graphics pipeline!");
 }
 
@@ -218,4 +223,53 @@ void Pipeline::clean() {
 	pipeline = nullptr;
 }
 
+void ComputePipeline::init(const Device &device, const Shader &shader, const std::initializer_list<VkDescriptorSetLayout> setLayouts,
+						const uint32_t pushConstantSize, const VkSpecializationInfo *constants) {
+	clean();
+
+	const VkPushConstantRange pushConstantRange {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0u,
+		.size = pushConstantSize
+	};
+	const VkPipelineLayoutCreateInfo layoutInfo {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.setLayoutCount = (uint32_t) setLayouts.size(),
+		.pSetLayouts = setLayouts.begin(),
+		.pushConstantRangeCount = pushConstantSize ? 1u : 0u,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	if(vkCreatePipelineLayout(this->device = device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		THROW_ERROR("failed to create compute pipeline layout!");
+
+	const VkComputePipelineCreateInfo pipelineInfo {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0u,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = shader,
+			.pName = "main",
+			.pSpecializationInfo = constants
+		},
+		.layout = layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	if(vkCreateComputePipelines(device, device.getPipelineCache(), 1u, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		THROW_ERROR("failed to create compute pipeline!");
+}
+
+void ComputePipeline::clean() {
+	if(!pipeline) return;
+	vkDestroyPipelineLayout(device, layout, nullptr);
+	vkDestroyPipeline(device, pipeline, nullptr);
+	pipeline = nullptr;
+}
+
 }
\ No newline at end of file
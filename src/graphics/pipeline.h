@@ -7,15 +7,22 @@
 #include "renderpass.h"
 #include "descriptor.h"
 
+#include <initializer_list>
+#include <span>
+
 namespace gfx {
 
 class Shader {
 public:
 	Shader(const Device &device, const char* name);
+	// SPIR-V embedded in the binary, see shaders/spirv.h
+	Shader(const Device &device, std::span<const uint32_t> code);
 	~Shader() { clean(); }
 	void clean();
 	inline operator VkShaderModule() const { return shader; }
 private:
+	void create(const Device &device, std::span<const uint32_t> code);
+
 	VkShaderModule shader = nullptr;
 	VkDevice device;
 };
@@ -24,8 +31,14 @@ class Pipeline {
 public:
 	~Pipeline() { clean(); }
 
+	// vertexInput comes from a VertexDescription, vertexConstants set the specialization constants of the vertex shader
+	// and the vertex shader receives pushConstantSize bytes of push constants.
+	// The sets of descriptorPool are bound at set 0, the ones of objectLayout, if any, at set 1.
 	void init(const Device &device, const Shader &vertexShader, const Shader &fragmentShader,
-				const DescriptorPool &descriptorPool, const RenderPass &renderPass);
+				const DescriptorPool &descriptorPool, const RenderPass &renderPass,
+				const VkPipelineVertexInputStateCreateInfo &vertexInput,
+				const VkSpecializationInfo *vertexConstants = nullptr, uint32_t pushConstantSize = 0u,
+				VkDescriptorSetLayout objectLayout = VK_NULL_HANDLE);
 	void clean();
 
 	inline operator VkPipeline() const { return pipeline; }
@@ -37,4 +50,23 @@ private:
 	VkDevice device;
 };
 
+class ComputePipeline {
+public:
+	~ComputePipeline() { clean(); }
+
+	// The sets of setLayouts[i] are bound at set i, constants set the specialization constants of the shader
+	// and the shader receives pushConstantSize bytes of push constants.
+	void init(const Device &device, const Shader &shader, std::initializer_list<VkDescriptorSetLayout> setLayouts,
+				uint32_t pushConstantSize = 0u, const VkSpecializationInfo *constants = nullptr);
+	void clean();
+
+	inline operator VkPipeline() const { return pipeline; }
+	inline VkPipelineLayout getLayout() const { return layout; }
+
+private:
+	VkPipeline pipeline = nullptr;
+	VkPipelineLayout layout;
+	VkDevice device;
+};
+
 }
\ No newline at end of file
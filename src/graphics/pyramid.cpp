@@ -0,0 +1,181 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "pyramid.h"
+
+#include "debug.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace gfx {
+
+// Texels of a level written by a workgroup of hiz.comp along each axis
+static constexpr uint32_t GROUP_SIZE = 8u;
+
+static VkDescriptorSetLayout createLayout(const Device &device, const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+	const VkDescriptorSetLayoutCreateInfo layoutInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.bindingCount = (uint32_t) bindings.size(),
+		.pBindings = bindings.data()
+	};
+	VkDescriptorSetLayout layout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		THROW_ERROR("failed to create depth pyramid set layout!");
+	return layout;
+}
+
+void DepthPyramid::init(const Device &device, const Shader &buildShader, const DepthImage &depthImage, const VkExtent2D extent) {
+	clean();
+	this->device = &device;
+
+	// Depths are read texel by texel, the sampler never filters
+	const VkSamplerCreateInfo samplerInfo {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mipLodBias = 0.f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.f,
+		.maxLod = VK_LOD_CLAMP_NONE,
+		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+		.unnormalizedCoordinates = VK_FALSE
+	};
+	if(vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		THROW_ERROR("failed to create depth pyramid sampler!");
+
+	// A level is built from the depth image at binding 0 for the first one, from the previous level at binding 1 otherwise
+	buildLayout = createLayout(device, {
+		{ 0u, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1u, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+		{ 1u, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1u, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+		{ 2u, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1u, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+	});
+	readLayout = createLayout(device, {
+		{ 0u, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1u, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+	});
+	pipeline.init(device, buildShader, { buildLayout }, sizeof(uint32_t));
+
+	recreate(depthImage, extent);
+}
+
+void DepthPyramid::recreate(const DepthImage &depthImage, const VkExtent2D extent) {
+	cleanLevels();
+	size = { std::bit_floor(std::max(extent.width, 1u)), std::bit_floor(std::max(extent.height, 1u)) };
+	const uint32_t levels = std::bit_width(std::max(size.width, size.height));
+	image.init(*device, size, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, levels);
+	view = Image::createView(*device, image, 2, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+	levelViews.resize(levels);
+	for(uint32_t i = 0; i < levels; ++i)
+		levelViews[i] = Image::createView(*device, image, 2, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1u, i);
+
+	const VkDescriptorPoolSize poolSizes[] {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levels + 1u },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2u * levels }
+	};
+	const VkDescriptorPoolCreateInfo poolInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.maxSets = levels + 1u,
+		.poolSizeCount = (uint32_t) std::size(poolSizes),
+		.pPoolSizes = poolSizes
+	};
+	if(vkCreateDescriptorPool(*device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		THROW_ERROR("failed to create depth pyramid descriptor pool!");
+	std::vector<VkDescriptorSetLayout> layouts(levels, buildLayout);
+	layouts.push_back(readLayout);
+	const VkDescriptorSetAllocateInfo allocInfo {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = pool,
+		.descriptorSetCount = (uint32_t) layouts.size(),
+		.pSetLayouts = layouts.data()
+	};
+	buildSets.resize(layouts.size());
+	if(vkAllocateDescriptorSets(*device, &allocInfo, buildSets.data()) != VK_SUCCESS)
+		THROW_ERROR("failed to allocate depth pyramid descriptor sets!");
+	readSet = buildSets.back();
+	buildSets.pop_back();
+
+	// The first level reads the depth image and binds itself as the unused previous level
+	const VkDescriptorImageInfo depthInfo { sampler, depthImage.getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	const VkDescriptorImageInfo readInfo { sampler, view, VK_IMAGE_LAYOUT_GENERAL };
+	std::vector<VkDescriptorImageInfo> levelInfos(levels);
+	for(uint32_t i = 0; i < levels; ++i) levelInfos[i] = { VK_NULL_HANDLE, levelViews[i], VK_IMAGE_LAYOUT_GENERAL };
+	std::vector<VkWriteDescriptorSet> writes;
+	const auto write = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo *info) {
+		writes.push_back({
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = set,
+			.dstBinding = binding,
+			.dstArrayElement = 0u,
+			.descriptorCount = 1u,
+			.descriptorType = type,
+			.pImageInfo = info,
+			.pBufferInfo = nullptr,
+			.pTexelBufferView = nullptr
+		});
+	};
+	for(uint32_t i = 0; i < levels; ++i) {
+		// Without sampling the depth the pyramid is never built, its sets are only bound
+		if(depthImage.isSampled()) write(buildSets[i], 0u, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &depthInfo);
+		write(buildSets[i], 1u, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &levelInfos[i ? i - 1 : 0]);
+		write(buildSets[i], 2u, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &levelInfos[i]);
+	}
+	write(readSet, 0u, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &readInfo);
+	vkUpdateDescriptorSets(*device, (uint32_t) writes.size(), writes.data(), 0u, nullptr);
+}
+
+void DepthPyramid::cleanLevels() {
+	if(!pool) return;
+	// Destroying the pool frees its sets
+	vkDestroyDescriptorPool(*device, pool, nullptr);
+	for(VkImageView levelView : levelViews) vkDestroyImageView(*device, levelView, nullptr);
+	levelViews.clear();
+	vkDestroyImageView(*device, view, nullptr);
+	image.clean();
+	pool = nullptr;
+}
+
+void DepthPyramid::clean() {
+	if(!device) return;
+	cleanLevels();
+	pipeline.clean();
+	vkDestroyDescriptorSetLayout(*device, readLayout, nullptr);
+	vkDestroyDescriptorSetLayout(*device, buildLayout, nullptr);
+	vkDestroySampler(*device, sampler, nullptr);
+	device = nullptr;
+}
+
+void DepthPyramid::record(CommandBuffer &cmd) const {
+	// The previous content is discarded once read
+	cmd
+		.layoutBarrier(image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0u, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT)
+		.bindPipeline(pipeline);
+	for(uint32_t i = 0; i < (uint32_t) buildSets.size(); ++i) {
+		const uint32_t width = std::max(size.width >> i, 1u), height = std::max(size.height >> i, 1u);
+		cmd
+			.bindDescriptorSet(pipeline, buildSets[i])
+			.pushConstants(pipeline, sizeof(i), &i)
+			.dispatch((width + GROUP_SIZE - 1u) / GROUP_SIZE, (height + GROUP_SIZE - 1u) / GROUP_SIZE)
+			.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "commandbuffer.h"
+#include "image.h"
+#include "pipeline.h"
+
+#include <vector>
+
+namespace gfx {
+
+// Mip chain of the farthest depths of a DepthImage, read by the occlusion culling. The level 0 has the largest power of
+// two size fitting in the depth image and every level halves the previous one down to a single texel, each texel
+// holding the farthest depth of the texels it covers. The pyramid stays in the general layout.
+class DepthPyramid {
+public:
+	~DepthPyramid() { clean(); }
+
+	// buildShader is hiz.comp
+	void init(const Device &device, const Shader &buildShader, const DepthImage &depthImage, VkExtent2D extent);
+	// Follow the size of the depth image, the content is lost
+	void recreate(const DepthImage &depthImage, VkExtent2D extent);
+	void clean();
+
+	// Build every level from depthImage, which is in the shader read only layout. The pyramid is then visible to the
+	// compute shaders recorded after it, the reads recorded before it are done.
+	void record(CommandBuffer &cmd) const;
+
+	// Set of the whole pyramid at the binding 0 of its layout, a sampler to read with texelFetch
+	inline VkDescriptorSetLayout getLayout() const { return readLayout; }
+	inline VkDescriptorSet getSet() const { return readSet; }
+	inline VkImage getImage() const { return image; }
+
+private:
+	void cleanLevels();
+
+	const Device *device = nullptr;
+	Image image;
+	VkExtent2D size;
+	VkImageView view;
+	std::vector<VkImageView> levelViews;
+	VkSampler sampler;
+	VkDescriptorSetLayout buildLayout, readLayout;
+	VkDescriptorPool pool = nullptr;
+	std::vector<VkDescriptorSet> buildSets;
+	VkDescriptorSet readSet;
+	ComputePipeline pipeline;
+};
+
+}
\ No newline at end of file
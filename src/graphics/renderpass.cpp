@@ -26,7 +26,8 @@ void RenderPass::init(const Device &device, const Swapchain &swapchain, const De
 			// .samples = msaaSamples,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
 			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			// The depth pyramid is built from the depth rendered so far
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -89,7 +90,7 @@ void RenderPass::init(const Device &device, const Swapchain &swapchain, const De
 		.dependencyFlags = 0u
 	};
 
-	const VkRenderPassCreateInfo passInfo {
+	VkRenderPassCreateInfo passInfo {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0u,
@@ -103,6 +104,25 @@ void RenderPass::init(const Device &device, const Swapchain &swapchain, const De
 
 	if(vkCreateRenderPass(this->device = device, &passInfo, nullptr, &pass) != VK_SUCCESS)
 		THROW_ERROR("failed to create render pass!");
+
+	// Same attachments kept from a previous pass, so that its framebuffers and pipelines are compatible
+	for(VkAttachmentDescription &attachment : attachments) {
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.initialLayout = attachment.finalLayout;
+	}
+	const VkSubpassDependency resumeDependency {
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0u,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dependencyFlags = 0u
+	};
+	passInfo.pDependencies = &resumeDependency;
+	if(vkCreateRenderPass(device, &passInfo, nullptr, &resumePass) != VK_SUCCESS)
+		THROW_ERROR("failed to create resumed render pass!");
 	
 	initFramebuffers(swapchain, depthImage);
 }
@@ -142,6 +162,7 @@ void RenderPass::initFramebuffers(const Swapchain &swapchain, const DepthImage &
 void RenderPass::clean() {
 	if(!pass) return;
 	cleanFramebuffers();
+	vkDestroyRenderPass(device, resumePass, nullptr);
 	vkDestroyRenderPass(device, pass, nullptr);
 	pass = nullptr;
 }
@@ -15,12 +15,14 @@ public:
 	void cleanFramebuffers();
 
 	inline operator VkRenderPass() const { return pass; }
+	// Pass loading the attachments left by a previous pass on the same framebuffer, instead of clearing them
+	inline VkRenderPass resumed() const { return resumePass; }
 
 	inline std::size_t size() const { return framebuffers.size(); }
 	inline VkFramebuffer framebuffer(std::size_t i) const { return framebuffers[i]; }
 
 protected:
-	VkRenderPass pass;
+	VkRenderPass pass, resumePass;
 	std::vector<VkFramebuffer> framebuffers;
 
 	VkDevice device;
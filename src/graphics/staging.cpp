@@ -0,0 +1,310 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "staging.h"
+
+#include "debug.h"
+
+#include <algorithm>
+
+namespace gfx {
+
+// Staged data starts on multiples of this alignment for the copies and the memcpy of the callers
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16u;
+
+// Uses of the uploaded buffers on the graphics queue: vertex and index buffers, storage buffers of the shaders and transfers
+static constexpr VkPipelineStageFlags GRAPHICS_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+	| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+static constexpr VkAccessFlags GRAPHICS_ACCESSES = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+	| VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+void StagingRing::init(const Device &device, const VkDeviceSize capacity) {
+	clean();
+	this->device = &device;
+	this->capacity = capacity;
+	ring = Buffer::createStagingBuffer(device, capacity);
+	memory = static_cast<char*>(ring.mapMemory());
+	head = tail = 0u;
+	nextToken = 1u;
+	completed = 0u;
+	const QueueFamilies &families = device.getQueueFamilies();
+	dedicated = families.transferId != families.graphicsId;
+	if(dedicated) {
+		transferFamily = families.transferId;
+		graphicsFamily = families.graphicsId;
+		uploads.init(device);
+		graphics.init(device);
+		graphicsValue = 0u;
+	}
+}
+
+void StagingRing::clean() {
+	if(!device) return;
+	if(recording) {
+		current.cmd.end();
+		if(dedicated) device->freeTransferCommandBuffers(&current.cmd, 1u);
+		else device->freeCommandBuffers(&current.cmd, 1u);
+		current.released.clear();
+		recording = false;
+	}
+	while(!inFlight.empty()) {
+		waitBatch(inFlight.front());
+		popBatch();
+	}
+	for(VkFence fence : fences) vkDestroyFence(*device, fence, nullptr);
+	fences.clear();
+	written.clear();
+	kept.clear();
+	unacquired.clear();
+	uploads.clean();
+	graphics.clean();
+	ring.clean();
+	device = nullptr;
+}
+
+CommandBuffer& StagingRing::record() {
+	if(recording) return current.cmd;
+	current.cmd = dedicated ? device->createTransferCommandBuffer() : device->createCommandBuffer();
+	current.handover = false;
+	current.dedicatedSize = 0u;
+	// The copies of the previous batches are done before the ones of this batch
+	current.cmd.beginOT().memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+	recording = true;
+	return current.cmd;
+}
+
+void StagingRing::keep(const Buffer &buffer) {
+	// Buffers written earlier in the batch are already owned by the transfer family
+	if(!dedicated || buffer.isShared() || std::ranges::find(written, (VkBuffer) buffer) != written.end()) return;
+	if(std::ranges::find(kept, (VkBuffer) buffer) == kept.end()) kept.push_back(buffer);
+}
+
+void StagingRing::write(const Buffer &dst, const bool keepContent) {
+	if(!dedicated || dst.isShared()) return;
+	if(keepContent) keep(dst);
+	if(std::ranges::find(written, (VkBuffer) dst) == written.end()) written.push_back(dst);
+}
+
+void* StagingRing::stage(Buffer &dst, const VkDeviceSize size, const VkDeviceSize dstOffset) {
+	if(2u * size > capacity) {
+		// Too big for the ring, the batch is submitted early when such buffers pile up
+		if(recording && current.dedicatedSize > 2u * capacity) flush();
+		Buffer tmp = Buffer::createStagingBuffer(*device, size);
+		void* data = tmp.mapMemory();
+		record().copyBuffer(tmp, dst, size, 0u, dstOffset);
+		write(dst, dstOffset > 0u);
+		current.dedicatedSize += size;
+		current.released.push_back(std::move(tmp));
+		return data;
+	}
+
+	uint64_t begin = (head + STAGING_ALIGNMENT - 1u) & ~(STAGING_ALIGNMENT - 1u);
+	for(;;) {
+		if(begin % capacity + size > capacity) begin += capacity - begin % capacity; // Wrap around
+		if(begin + size - tail <= capacity) break;
+		// Wait for the oldest batch, or for the current one when it holds the whole ring
+		if(inFlight.empty()) {
+			if(!recording) {
+				begin = head = tail = 0u;
+				continue;
+			}
+			flush();
+		}
+		waitBatch(inFlight.front());
+		popBatch();
+	}
+	head = begin + size;
+	record().copyBuffer(ring, dst, size, begin % capacity, dstOffset);
+	write(dst, dstOffset > 0u);
+	return memory + begin % capacity;
+}
+
+void StagingRing::copy(const Buffer &src, Buffer &dst, const VkDeviceSize size, const VkDeviceSize srcOffset, const VkDeviceSize dstOffset) {
+	// src may have been written earlier in the batch
+	record().memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+	current.cmd.copyBuffer(src, dst, size, srcOffset, dstOffset);
+	keep(src);
+	write(dst, dstOffset > 0u);
+}
+
+void StagingRing::release(Buffer &&buffer) {
+	record();
+	// A destroyed buffer is never acquired
+	const VkBuffer b = buffer;
+	std::erase(written, b);
+	std::erase_if(unacquired, [&](const std::pair<VkBuffer, UploadToken> &u) { return u.first == b; });
+	current.released.push_back(std::move(buffer));
+}
+
+UploadToken StagingRing::flush() {
+	reclaim();
+	if(!recording) return nextToken - 1u;
+	current.token = nextToken++;
+	current.end = head;
+	if(dedicated) submitTransfer();
+	else submitGraphics();
+	inFlight.push_back(std::move(current));
+	current.released.clear();
+	recording = false;
+	return inFlight.back().token;
+}
+
+void StagingRing::submitGraphics() {
+	// Vertex and index buffers, storage buffers of the shaders and later transfers see the copies
+	current.cmd.memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, GRAPHICS_STAGES, GRAPHICS_ACCESSES).end();
+	if(fences.empty()) {
+		const VkFenceCreateInfo fenceInfo {
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0u
+		};
+		VkFence fence;
+		if(vkCreateFence(*device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+			THROW_ERROR("failed to create upload fence!");
+		fences.push_back(fence);
+	}
+	current.fence = fences.back();
+	fences.pop_back();
+	CommandBuffer::submit(*device, &current.cmd, 1u, device->getGraphicsQueue(), {}, {}, current.fence);
+}
+
+void StagingRing::submitTransfer() {
+	CommandBuffer cmds[2];
+	uint32_t count = 0u;
+	SemaphoreSubmit handover;
+	if(!kept.empty()) {
+		// The graphics queue hands the kept buffers over after the submits using them, taking back first the ones
+		// still released by the previous batches
+		std::vector<VkBuffer> previous;
+		UploadToken last = 0u;
+		std::erase_if(unacquired, [&](const std::pair<VkBuffer, UploadToken> &u) {
+			if(std::ranges::find(kept, u.first) == kept.end()) return false;
+			previous.push_back(u.first);
+			last = std::max(last, u.second);
+			return true;
+		});
+		current.ownership = device->createCommandBuffer();
+		current.ownership.beginOT()
+			.ownershipBarrier(previous, transferFamily, graphicsFamily, GRAPHICS_STAGES, 0u, GRAPHICS_STAGES, GRAPHICS_ACCESSES)
+			.ownershipBarrier(kept, graphicsFamily, transferFamily, GRAPHICS_STAGES,
+				VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u)
+			.end();
+		CommandBuffer::submit(*device, &current.ownership, 1u, device->getGraphicsQueue(),
+			{ { last ? (VkSemaphore) uploads : VK_NULL_HANDLE, last, GRAPHICS_STAGES } }, { graphicsSignal() });
+		current.prologue = device->createTransferCommandBuffer();
+		current.prologue.beginOT()
+			.ownershipBarrier(kept, graphicsFamily, transferFamily, VK_PIPELINE_STAGE_TRANSFER_BIT, 0u,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)
+			.end();
+		current.handover = true;
+		cmds[count++] = current.prologue;
+		handover = { graphics, graphicsValue, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	}
+
+	// The written buffers are acquired by the next graphics submits using them
+	current.cmd.ownershipBarrier(written, transferFamily, graphicsFamily, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u).end();
+	for(const VkBuffer buffer : written) {
+		std::erase_if(unacquired, [&](const std::pair<VkBuffer, UploadToken> &u) { return u.first == buffer; });
+		unacquired.emplace_back(buffer, current.token);
+	}
+	written.clear();
+	kept.clear();
+	cmds[count++] = current.cmd;
+	current.graphicsValue = graphicsValue;
+	CommandBuffer::submit(*device, cmds, count, device->getTransferQueue(), { handover }, { { uploads, current.token } });
+}
+
+bool StagingRing::isDone(const Batch &batch) const {
+	if(!dedicated) return vkGetFenceStatus(*device, batch.fence) == VK_SUCCESS;
+	return uploads.value() >= batch.token && graphics.value() >= batch.graphicsValue;
+}
+
+void StagingRing::waitBatch(const Batch &batch) const {
+	if(!dedicated) {
+		vkWaitForFences(*device, 1u, &batch.fence, VK_TRUE, UINT64_MAX);
+		return;
+	}
+	uploads.wait(batch.token);
+	graphics.wait(batch.graphicsValue);
+}
+
+void StagingRing::popBatch() {
+	Batch &batch = inFlight.front();
+	if(dedicated) {
+		device->freeTransferCommandBuffers(&batch.cmd, 1u);
+		if(batch.handover) {
+			device->freeCommandBuffers(&batch.ownership, 1u);
+			device->freeTransferCommandBuffers(&batch.prologue, 1u);
+		}
+	} else {
+		vkResetFences(*device, 1u, &batch.fence);
+		fences.push_back(batch.fence);
+		device->freeCommandBuffers(&batch.cmd, 1u);
+	}
+	tail = batch.end;
+	completed = batch.token;
+	inFlight.pop_front();
+}
+
+void StagingRing::reclaim() {
+	while(!inFlight.empty() && isDone(inFlight.front())) popBatch();
+	if(inFlight.empty() && !recording) head = tail = 0u;
+}
+
+bool StagingRing::isComplete(const UploadToken token) {
+	reclaim();
+	return token <= completed;
+}
+
+void StagingRing::wait(const UploadToken token) {
+	if(token == nextToken && recording) flush();
+	while(completed < token && !inFlight.empty()) {
+		waitBatch(inFlight.front());
+		popBatch();
+	}
+}
+
+void StagingRing::finish() {
+	const UploadToken token = flush();
+	if(dedicated && !unacquired.empty()) {
+		CommandBuffer cmd = device->createCommandBuffer();
+		cmd.beginOT();
+		const SemaphoreSubmit uploaded = acquire(cmd, token);
+		cmd.end();
+		CommandBuffer::submit(*device, &cmd, 1u, device->getGraphicsQueue(), { uploaded }, { graphicsSignal() });
+		graphics.wait(graphicsValue);
+		device->freeCommandBuffers(&cmd, 1u);
+	}
+	wait(token);
+}
+
+UploadToken StagingRing::readyToken() const {
+	// The graphics queue runs its batches before the next submits
+	if(!dedicated) return nextToken - 1u;
+	return uploads.value();
+}
+
+SemaphoreSubmit StagingRing::acquire(CommandBuffer &cmd, const UploadToken token) {
+	if(!dedicated || !token) return {};
+	std::vector<VkBuffer> buffers;
+	std::erase_if(unacquired, [&](const std::pair<VkBuffer, UploadToken> &u) {
+		if(u.second > token) return false;
+		buffers.push_back(u.first);
+		return true;
+	});
+	if(!buffers.empty())
+		cmd.ownershipBarrier(buffers, transferFamily, graphicsFamily, GRAPHICS_STAGES, 0u, GRAPHICS_STAGES, GRAPHICS_ACCESSES);
+	// Shared buffers are not acquired, the wait alone makes their copies visible
+	return { uploads, token, GRAPHICS_STAGES };
+}
+
+SemaphoreSubmit StagingRing::graphicsSignal() {
+	if(!dedicated) return {};
+	return { graphics, ++graphicsValue };
+}
+
+}
\ No newline at end of file
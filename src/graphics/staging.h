@@ -0,0 +1,110 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include "buffer.h"
+#include "commandbuffer.h"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace gfx {
+
+// Batch of uploads, a token is complete once the GPU executed the copies of its batch
+using UploadToken = uint64_t;
+
+// Persistently mapped ring of staging memory. Uploads write their data in the ring and record their copy in the
+// current batch, flush() submits the batch without waiting for it. The ring memory of a batch is reclaimed once
+// it is complete. Uploads bigger than half the ring get their own staging buffer, released with their batch.
+//
+// When the device has a dedicated transfer family, batches run on its queue beside rendering. They signal their token
+// on a timeline semaphore and release the buffers they write to the graphics family, the graphics submits acquire
+// them with acquire() and wait for the semaphore. The graphics queue first releases to the transfer family the
+// buffers whose content is kept by a batch. Shared buffers skip the hand overs. Otherwise batches run on the graphics
+// queue before the next submits.
+class StagingRing {
+public:
+	~StagingRing() { clean(); }
+
+	void init(const Device &device, VkDeviceSize capacity);
+	void clean();
+
+	// Staging memory of `size` bytes copied to dst at dstOffset by the current batch, dst keeps its content before dstOffset
+	void* stage(Buffer &dst, VkDeviceSize size, VkDeviceSize dstOffset = 0u);
+	inline void upload(Buffer &dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0u) {
+		memcpy(stage(dst, size, dstOffset), data, (size_t) size);
+	}
+	// Copy between device buffers in the current batch, after the copies already recorded
+	void copy(const Buffer &src, Buffer &dst, VkDeviceSize size, VkDeviceSize srcOffset = 0u, VkDeviceSize dstOffset = 0u);
+	// Destroy buffer once the current batch and the graphics submits already done are complete
+	void release(Buffer &&buffer);
+
+	// Submit the current batch, its writes are visible to the graphics submits after it
+	UploadToken flush();
+	// Flush and wait for every upload, the graphics queue owns their buffers when it returns
+	void finish();
+	// Token of the batch with the last upload, the one being recorded if any
+	inline UploadToken currentToken() const { return recording ? nextToken : nextToken - 1u; }
+	bool isComplete(UploadToken token);
+	void wait(UploadToken token);
+	// Release the staging memory of the complete batches
+	void reclaim();
+
+	// Last token that the next graphics submit can use without waiting for the transfer queue
+	UploadToken readyToken() const;
+	// Record in cmd, before the commands of a graphics submit, the acquisition of the buffers uploaded up to token.
+	// The submit waits for the semaphore returned, token must be flushed.
+	SemaphoreSubmit acquire(CommandBuffer &cmd, UploadToken token);
+	// Semaphore signaled by every graphics submit using the buffers of the ring, released buffers outlive these submits
+	SemaphoreSubmit graphicsSignal();
+
+private:
+	struct Batch {
+		UploadToken token;
+		CommandBuffer cmd;
+		// Hand over of the kept buffers, released by the graphics queue then acquired by the transfer queue
+		CommandBuffer ownership, prologue;
+		bool handover;
+		VkFence fence;
+		uint64_t graphicsValue; // Graphics submits done before the batch
+		uint64_t end; // Ring position after the data of the batch
+		std::vector<Buffer> released;
+		VkDeviceSize dedicatedSize;
+	};
+
+	CommandBuffer& record();
+	// Buffers written by the current batch, the content of the kept ones outside the writes is preserved
+	void write(const Buffer &dst, bool keepContent);
+	void keep(const Buffer &buffer);
+	void submitTransfer();
+	void submitGraphics();
+	bool isDone(const Batch &batch) const;
+	void waitBatch(const Batch &batch) const;
+	void popBatch();
+
+	const Device *device = nullptr;
+	Buffer ring;
+	char* memory;
+	// Positions only increase, the ring holds the staged data from tail to head
+	VkDeviceSize capacity;
+	uint64_t head = 0u, tail = 0u;
+
+	Batch current;
+	bool recording = false;
+	std::deque<Batch> inFlight;
+	std::vector<VkFence> fences; // Unsignaled fences of the finished batches
+	UploadToken nextToken = 1u, completed = 0u;
+
+	// Dedicated transfer queue
+	bool dedicated = false;
+	uint32_t transferFamily, graphicsFamily;
+	TimelineSemaphore uploads, graphics; // Tokens of the batches, graphics submits
+	uint64_t graphicsValue = 0u;
+	std::vector<VkBuffer> written, kept;
+	std::vector<std::pair<VkBuffer, UploadToken>> unacquired; // Released to the graphics family by the batch of the token
+};
+
+}
\ No newline at end of file
@@ -69,4 +69,66 @@ private:
 	VkDevice device;
 };
 
+// Semaphore holding a 64 bits counter, submits signal and wait for values of the counter and the host reads it.
+// Needs a device with timeline semaphores.
+class TimelineSemaphore {
+public:
+	TimelineSemaphore() = default;
+	~TimelineSemaphore() { clean(); }
+
+	inline void init(const Device &device, uint64_t initialValue=0u) {
+		clean();
+		const VkSemaphoreTypeCreateInfo typeInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.pNext = nullptr,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = initialValue
+		};
+		const VkSemaphoreCreateInfo semInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &typeInfo,
+			.flags = 0u
+		};
+		if(vkCreateSemaphore(this->device = device, &semInfo, nullptr, &semaphore) != VK_SUCCESS)
+			THROW_ERROR("failed to create timeline semaphore!");
+	}
+
+	inline void clean() {
+		if(!semaphore) return;
+		vkDestroySemaphore(device, semaphore, nullptr);
+		semaphore = nullptr;
+	}
+
+	inline uint64_t value() const {
+		uint64_t v;
+		vkGetSemaphoreCounterValue(device, semaphore, &v);
+		return v;
+	}
+	inline void wait(uint64_t value) const {
+		const VkSemaphoreWaitInfo waitInfo {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.pNext = nullptr,
+			.flags = 0u,
+			.semaphoreCount = 1u,
+			.pSemaphores = &semaphore,
+			.pValues = &value
+		};
+		vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+	}
+
+	operator VkSemaphore() const { return semaphore; }
+
+private:
+	VkSemaphore semaphore = nullptr;
+	VkDevice device;
+};
+
+// Semaphore waited or signaled by a submit, value is the counter value of a timeline semaphore.
+// Submits skip the null semaphores.
+struct SemaphoreSubmit {
+	VkSemaphore semaphore = nullptr;
+	uint64_t value = 0u;
+	VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // First stage waiting for it
+};
+
 }
\ No newline at end of file
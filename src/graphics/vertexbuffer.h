@@ -7,6 +7,8 @@
 #include "buffer.h"
 #include "maths.h"
 
+#include <geometry/compact.h>
+
 #include <array>
 
 namespace gfx {
@@ -16,63 +18,107 @@ template<> constexpr VkFormat typeFormat<vec3>() { return VK_FORMAT_R64G64B64_SF
 template<> constexpr VkFormat typeFormat<vec2>() { return VK_FORMAT_R64G64_SFLOAT; }
 template<> constexpr VkFormat typeFormat<vec3f>() { return VK_FORMAT_R32G32B32_SFLOAT; }
 template<> constexpr VkFormat typeFormat<vec2f>() { return VK_FORMAT_R32G32_SFLOAT; }
+template<> constexpr VkFormat typeFormat<float>() { return VK_FORMAT_R32_SFLOAT; }
+template<> constexpr VkFormat typeFormat<unorm16x4>() { return VK_FORMAT_R16G16B16A16_UNORM; }
+template<> constexpr VkFormat typeFormat<snorm16x2>() { return VK_FORMAT_R16G16_SNORM; }
+template<> constexpr VkFormat typeFormat<half2>() { return VK_FORMAT_R16G16_SFLOAT; }
 
+// Vertex attributes stored in separate streams: attribute i is read at location i from binding i,
+// so that each stream lives in its own buffer, bound and uploaded independently of the others.
 template<typename... T>
 struct VertexDescription {
-	constexpr static VkVertexInputBindingDescription getBindingDescription() {
-		return VkVertexInputBindingDescription {
-			.binding = 0u,
-			.stride = (sizeof(T) + ...),
-			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-		};
+	constexpr static uint BINDING_COUNT = sizeof...(T);
+	constexpr static std::array<VkDeviceSize, sizeof...(T)> STRIDES { sizeof(T) ... };
+
+	constexpr static std::array<VkVertexInputBindingDescription, sizeof...(T)> getBindingDescriptions() {
+		uint strides[] { sizeof(T) ... };
+		std::array<VkVertexInputBindingDescription, sizeof...(T)> bindings;
+		for(uint i = 0; i < sizeof...(T); ++i) {
+			bindings[i].binding = i;
+			bindings[i].stride = strides[i];
+			bindings[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		return bindings;
 	}
 
 	constexpr static std::array<VkVertexInputAttributeDescription, sizeof...(T)> getAttributeDescription() {
 		VkFormat formats[] { typeFormat<T>() ... };
-		uint sizes[] { sizeof(T) ... };
 		std::array<VkVertexInputAttributeDescription, sizeof...(T)> attributes;
-		uint offset = 0u;
 		for(uint i = 0; i < sizeof...(T); ++i) {
 			attributes[i].location = i;
-			attributes[i].binding = 0u;
+			attributes[i].binding = i;
 			attributes[i].format = formats[i];
-			attributes[i].offset = offset;
-			offset += sizes[i];
+			attributes[i].offset = 0u;
 		}
 		return attributes;
 	}
+
+	// Vertex input state of the pipelines reading these streams
+	static VkPipelineVertexInputStateCreateInfo inputState() {
+		static constexpr std::array<VkVertexInputBindingDescription, sizeof...(T)> BINDINGS = getBindingDescriptions();
+		static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(T)> ATTRIBUTES = getAttributeDescription();
+		return {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0u,
+			.vertexBindingDescriptionCount = BINDING_COUNT,
+			.pVertexBindingDescriptions = BINDINGS.data(),
+			.vertexAttributeDescriptionCount = BINDING_COUNT,
+			.pVertexAttributeDescriptions = ATTRIBUTES.data()
+		};
+	}
 };
 
-struct Vertex : public VertexDescription<vec3f, vec3f, vec2f> {
-	vec3f pos;
-	vec3f normal;
-	vec2f uv;
+// Streams read by the pipeline, one value per corner, or per point for the smooth shaded meshes without corner
+// attributes. There is no stream of point attributes, no shading reads them.
+struct VertexLayout : public VertexDescription<vec3f, vec3f, vec2f> {
+	enum STREAM : uint { POSITION, NORMAL, UV };
 };
 
+// Same streams in 16 bytes per corner instead of 32, the vertex shader decodes them (see geometry/compact.h).
+// Positions need the quantization of their object.
+struct CompactVertexLayout : public VertexDescription<unorm16x4, snorm16x2, half2> {};
+static_assert(CompactVertexLayout::BINDING_COUNT == VertexLayout::BINDING_COUNT);
+
 class VertexBuffer : public Buffer {
 public:
 	VertexBuffer() = default;
 
-	inline void init(const Device &device, VkDeviceSize size) {
+	inline void init(const Device &device, VkDeviceSize size, bool shared = false) {
+		// Transfer source allows to grow the buffer by copying it in a bigger one
 		Buffer::init(device, size,
-				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shared);
 	}
-	inline void init(const Device &device, const Vertex *vertices, VkDeviceSize size) {
+	inline void init(const Device &device, const void *vertices, VkDeviceSize size) {
 		init(device, size);
 		const Buffer tmp = Buffer::createStagingBuffer(device, (void*) vertices, size);
 		Buffer::copy(device, tmp, *this, size);
 	}
 };
 
+// Array read by the shaders through a storage buffer descriptor
+class StorageBuffer : public Buffer {
+public:
+	StorageBuffer() = default;
+
+	inline void init(const Device &device, VkDeviceSize size, bool shared = false) {
+		// Transfer source allows to grow the buffer by copying it in a bigger one
+		Buffer::init(device, size,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shared);
+	}
+};
+
 class IndexBuffer : public Buffer {
 public:
 	IndexBuffer() = default;
 
-	inline void init(const Device &device, VkDeviceSize size) {
+	inline void init(const Device &device, VkDeviceSize size, bool shared = false) {
+		// Transfer source allows to grow the buffer by copying it in a bigger one
 		Buffer::init(device, size,
-				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shared);
 	}
 	inline void init(const Device &device, const uint32_t *indices, VkDeviceSize size) {
 		init(device, size);
@@ -0,0 +1,114 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "loader.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <geometry/triangulation.h>
+
+#include <algorithm>
+#include <chrono>
+
+template<typename M>
+void packPositions(const M &m, const std::size_t f0, const std::size_t f1, vec3f* out) {
+	const std::uint32_t fc0 = m.facet_begin(f0), fc1 = m.facet_begin(f1);
+	// Compact points are converted as they are read, without decoding the whole mesh
+	if(m.precision() == Precision::DOUBLE) simd::convertPoints(m.points.data(), m.facet_vertices.data() + fc0, fc1 - fc0, out);
+	else for(std::uint32_t fc = fc0; fc < fc1; ++fc) out[fc - fc0] = m.corner_point(fc);
+}
+
+template<typename M>
+void packFlatNormals(const M &m, const std::size_t f0, const std::size_t f1, vec3f* out) {
+	// Compact points are decoded chunk by chunk, for the three vertices of every corner
+	std::vector<vec3> decoded(m.precision() == Precision::DOUBLE ? 0u : 3u * simd::CHUNK_SIZE);
+	std::uint32_t prev[simd::CHUNK_SIZE], cur[simd::CHUNK_SIZE], next[simd::CHUNK_SIZE];
+	vec3 normals[simd::CHUNK_SIZE];
+	const std::uint32_t fc0 = m.facet_begin(f0);
+	std::uint32_t first = fc0, count = 0;
+	const auto flush = [&]() {
+		std::copy_n(m.facet_vertices.data() + first, count, cur);
+		const vec3* P = m.doublePoints(prev, count, decoded.data());
+		m.doublePoints(cur, count, decoded.data(), simd::CHUNK_SIZE);
+		m.doublePoints(next, count, decoded.data(), 2u * simd::CHUNK_SIZE);
+		simd::cornerNormals(P, prev, cur, next, count, false, normals);
+		simd::convertPoints(normals, nullptr, count, out + (first - fc0));
+		first += count;
+		count = 0;
+	};
+	for(std::uint32_t f = f0; f < f1; ++f) for(std::uint32_t fc = m.facet_begin(f); fc < m.facet_end(f); ++fc) {
+		prev[count] = m.facet_vertices[m.prev(f, fc)];
+		next[count] = m.facet_vertices[m.next(f, fc)];
+		if(++count == simd::CHUNK_SIZE) flush();
+	}
+	flush();
+}
+
+template<typename M>
+void packSmoothNormals(const M &m, const std::vector<vec3> &normals, const std::size_t f0, const std::size_t f1, vec3f* out) {
+	const std::uint32_t fc0 = m.facet_begin(f0);
+	simd::convertPoints(normals.data(), m.facet_vertices.data() + fc0, m.facet_begin(f1) - fc0, out);
+}
+
+template<typename M>
+void packUVs(const M &m, const std::size_t f0, const std::size_t f1, vec2f* out) {
+	const std::uint32_t fc0 = m.facet_begin(f0), fc1 = m.facet_begin(f1);
+	const Attribute* uv = m.facet_corner_attributes.empty() ? nullptr : &m.facet_corner_attributes[0];
+	const std::size_t size = uv ? std::min<std::size_t>(uv->size(), fc1) : 0u;
+	for(std::uint32_t fc = fc0; fc < fc1; ++fc) out[fc - fc0] = fc < size ? vec2f(uv->vec2_at(fc)) : vec2f(0.f, 0.f);
+}
+
+#define INSTANTIATE(M) \
+	template void packPositions(const M&, std::size_t, std::size_t, vec3f*); \
+	template void packFlatNormals(const M&, std::size_t, std::size_t, vec3f*); \
+	template void packSmoothNormals(const M&, const std::vector<vec3>&, std::size_t, std::size_t, vec3f*); \
+	template void packUVs(const M&, std::size_t, std::size_t, vec2f*);
+INSTANTIATE(Mesh)
+INSTANTIATE(TriMesh)
+INSTANTIATE(QuadMesh)
+#undef INSTANTIATE
+
+MeshStream::MeshStream(const std::string &filename) {
+	thread = std::thread(&MeshStream::run, this, filename);
+}
+
+MeshStream::~MeshStream() {
+	cancelled = true;
+	if(thread.joinable()) thread.join();
+}
+
+Mesh MeshStream::takeMesh() {
+	if(thread.joinable()) thread.join();
+	if(error) std::rethrow_exception(error);
+	return std::move(mesh);
+}
+
+void MeshStream::run(const std::string &filename) {
+	struct Cancelled {};
+	const ThreadShare share;
+	try {
+		streamMesh(filename.c_str(), mesh, [&](const Mesh &m, std::size_t first) {
+			for(std::size_t f0 = first; f0 < m.nfacets(); f0 += CHUNK_FACETS) {
+				const std::size_t f1 = std::min(f0 + CHUNK_FACETS, m.nfacets());
+				const std::size_t ncorners = m.facet_begin(f1) - m.facet_begin(f0);
+				Chunk chunk {
+					std::vector<vec3f>(ncorners), std::vector<vec3f>(ncorners), std::vector<vec2f>(ncorners),
+					triangulateFacets(m, f0, f1)
+				};
+				packPositions(m, f0, f1, chunk.positions.data());
+				packFlatNormals(m, f0, f1, chunk.normals.data());
+				packUVs(m, f0, f1, chunk.uvs.data());
+				// The queue is bounded so a fast parser waits for the render thread here
+				while(!queue.push(std::move(chunk))) {
+					if(cancelled) throw Cancelled();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		});
+	} catch(const Cancelled&) {
+	} catch(...) {
+		error = std::current_exception();
+	}
+	done.store(true, std::memory_order_release);
+}
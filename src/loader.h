@@ -0,0 +1,63 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <spscqueue.h>
+
+#include <geometry/mesh.h>
+#include <geometry/normals.h>
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The per corner functions below are instantiated for Mesh, TriMesh and QuadMesh
+
+// Vertex streams of the corners of the facets [f0, f1), written from out[0]:
+// corner points, facet normals, vertex normals `normals` and texture coordinates (zeros when there are none)
+template<typename M>
+void packPositions(const M &m, std::size_t f0, std::size_t f1, vec3f* out);
+template<typename M>
+void packFlatNormals(const M &m, std::size_t f0, std::size_t f1, vec3f* out);
+template<typename M>
+void packSmoothNormals(const M &m, const std::vector<vec3> &normals, std::size_t f0, std::size_t f1, vec3f* out);
+template<typename M>
+void packUVs(const M &m, std::size_t f0, std::size_t f1, vec2f* out);
+
+// Read a mesh on its own thread and send its facets, already packed as vertices and triangulated,
+// to the render thread as soon as they are parsed.
+class MeshStream {
+public:
+	constexpr static std::size_t CHUNK_FACETS = 1u << 14;
+
+	// Flat shaded vertex streams of the corners of consecutive facets,
+	// indices refer to corners of the whole mesh so they can be appended to the previous chunks
+	struct Chunk {
+		std::vector<vec3f> positions, normals;
+		std::vector<vec2f> uvs;
+		std::vector<std::uint32_t> indices;
+	};
+
+	explicit MeshStream(const std::string &filename);
+	MeshStream(const MeshStream&) = delete;
+	~MeshStream();
+
+	// True once every chunk has been pushed, chunks may still be waiting in the queue
+	inline bool finished() const { return done.load(std::memory_order_acquire); }
+	inline bool pop(Chunk &chunk) { return queue.pop(chunk); }
+	// Complete mesh once finished() is true, rethrows the error of the loader thread if any
+	Mesh takeMesh();
+
+private:
+	void run(const std::string &filename);
+
+	SPSCQueue<Chunk, 64> queue;
+	std::atomic<bool> done = false, cancelled = false;
+	std::exception_ptr error;
+	Mesh mesh;
+	std::thread thread;
+};
@@ -6,12 +6,16 @@
 
 #include <config.h>
 
+#include <graphics/arena.h>
 #include <graphics/renderpass.h>
 #include <graphics/pipeline.h>
+#include <graphics/pyramid.h>
 #include <graphics/commandbuffer.h>
+#include <graphics/staging.h>
 #include <graphics/sync.h>
 #include <graphics/gui.h>
 #include <graphics/vertexbuffer.h>
+#include <spirv.h> // SPIR-V of the shaders, generated by shaders/CMakeLists.txt
 
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
@@ -20,21 +24,152 @@
 #define LUA_BINDER_IMPL
 #include <lua/luabinder.h>
 
+#include <geometry/compact.h>
+#include <geometry/lod.h>
 #include <geometry/mesh.h>
+#include <geometry/meshlets.h>
+#include <geometry/normals.h>
+#include <geometry/triangulation.h>
+#include <loader.h>
+#include <parallel.h>
+#include <simd.h>
+#include <timer.h>
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <optional>
 
 const char* APP_NAME = "Visu";
 
-class Object : public Mesh {
+// Layouts of the vertex data of the objects, in the order of the Vertex Format preference
+enum class VertexFormat { FULL, COMPACT, PULLED };
+
+// Arrays of the mesh read by the vertex shader with the PULLED format, in the order of the bindings of pulled.vert
+enum MeshArray : unsigned { POINTS, FACET_VERTICES, FACET_OFFSET, CORNER_UVS, VERTEX_NORMALS, MESH_ARRAY_COUNT };
+
+// Constants of a drawn object: quantization of its positions, sizes of the arrays pulled by pulled.vert and surface color.
+// Push constants of pulled.vert, test.vert reads them in the objects of its frame. Point vertices get flat normals from
+// test.frag when smoothNormals is 0.
+struct ObjectConstants {
+	alignas(16) vec3f origin, extent;
+	std::uint32_t nfacets = 0u, nuvs = 0u, smoothNormals = 0u, pointVertices = 0u;
+	alignas(16) vec3f color;
+};
+
+// Object of an arena read by cull.comp: its meshlets, numbered from meshletStart in the dispatch, and its draw parameters.
+// The shader raises visible when it draws one of its meshlets and occluded when one stays hidden.
+struct CullObject {
+	std::uint32_t firstMeshlet, meshletCount, meshletStart, firstIndex;
+	std::int32_t vertexOffset;
+	std::uint32_t instance, visible, occluded;
+};
+// Counters of cull.comp, followed by the CullObjects of the frame: indirect draws of each arena in both phases, meshlets
+// left to the second phase, culled meshlets and triangles drawn
+struct CullCounters {
+	std::uint32_t drawCounts[2], lateDrawCounts[2], hiddenCounts[2];
+	std::uint32_t frustumCulled, backfaceCulled, occludedMeshlets, occludedTriangles, drawnTriangles;
+};
+// Push constants of cull.comp, the objects and draws of an arena in the ones of the frame, then the camera of the depth
+// in the pyramid
+struct CullPass {
+	std::uint32_t firstObject, objectCount, meshletCount, arena, firstDraw, lateDraws, phase, occlusion;
+	alignas(16) vec3f center, u, v, w;
+};
+
+// Triangles of a mesh in an arena range and their meshlets, either its full resolution or its coarser levels of detail
+// one after the other. They are built by worker threads then kept for the next uploads, since they only depend on its
+// connectivity and its points.
+struct RangeGeometry {
+	// Levels of detail drawn from the range, coarser and coarser ones, their triangles and meshlets relative to the ones
+	// of the range. error estimates the distance to the full resolution, see Lod.
+	struct Level {
+		std::uint32_t firstIndex, indexCount, firstMeshlet, meshletCount;
+		float error;
+	};
+	std::vector<std::uint32_t> indices;
+	std::vector<Meshlet> meshlets;
+	std::vector<Level> levels;
+};
+
+// Mesh read by a worker thread, in the chosen storage and with the geometry of its range
+struct LoadedMesh {
+	AnyMesh mesh;
+	RangeGeometry geometry;
+	std::vector<vec3> smoothNormals; // Of the meshes drawn with point vertices, which always read them
+};
+
+class Object {
 public:
 	std::string name;
-	// TODO: merge memory of buffers in one allocation and maybe merge buffers and use offset
-	gfx::VertexBuffer vertexBuffer;
+	AnyMesh mesh;
+	RangeGeometry geometry;
+	// Coarser levels of detail, built by a worker thread once the object is created while its full resolution is drawn.
+	// They are in their own range of the arena, indexing the vertices of `range`, and drawn once uploaded. The job reads
+	// the mesh and the full resolution, which outlive it since the future is destroyed first.
+	RangeGeometry lods;
+	std::future<RangeGeometry> lodJob;
+	// Vertices and triangles of the finished meshes in the full and compact formats, in the arena of their format
+	gfx::GeometryArena *arena = nullptr;
+	gfx::GeometryArena::Range range, lodRange;
+	gfx::UploadToken lodsUploaded = 0u;
+	// Streamed vertices have their own buffers, one per stream of gfx::VertexLayout, to grow while the others are drawn
+	std::array<gfx::VertexBuffer, gfx::VertexLayout::BINDING_COUNT> vertexBuffers;
+	std::array<VkDeviceSize, gfx::VertexLayout::BINDING_COUNT> vertexCapacities {};
+	// Triangles of the streamed or pulled vertices
+	gfx::IndexBuffer indexBuffer;
+	VkDeviceSize indexCapacity = 0u;
+	std::uint32_t indexCount = 0u;
+	// Arrays of the mesh and their descriptor set when the vertices are pulled, the index buffer then holds facet corners
+	std::array<gfx::StorageBuffer, MESH_ARRAY_COUNT> meshArrays;
+	std::array<VkDeviceSize, MESH_ARRAY_COUNT> meshArrayCapacities {};
+	gfx::StorageSet meshArraySet;
+	// Smooth normals of the pulled vertices, asked for by the shading then computed by the next frame drawing the object
+	bool vertexNormalsPending = false, vertexNormalsReady = false;
+	// Batch of the last upload to the buffers
+	gfx::UploadToken uploaded = 0u;
+	// The range has a vertex per point instead of one per corner, see usePointVertices
+	bool pointVertices = false;
+	// Set when the stream of the object has just finished, the next frame waits for its range instead of hiding it
+	bool streamFinished = false;
+	// Layout of the vertex data, compact streams and pulled arrays are decoded with `constants`
+	VertexFormat format = VertexFormat::FULL;
+	ObjectConstants constants { vec3f(0.f), vec3f(1.f, 1.f, 1.f) };
 	float surfaceColor[3];
+
+	// Smooth shading data computed on the first use, the adjacency stays valid as long as the connectivity
+	VertexCorners vertexCorners;
+	std::vector<vec3> smoothNormals;
+
+	// Progressive loading: vertex streams and triangles received so far, the mesh itself is available once the stream is finished
+	std::unique_ptr<MeshStream> stream;
+	// Mesh of the finished stream being prepared by a worker thread, the streamed vertices are drawn meanwhile
+	std::future<LoadedMesh> prepared;
+	std::vector<vec3f> streamedPositions, streamedNormals;
+	std::vector<vec2f> streamedUVs;
+	std::vector<std::uint32_t> streamedIndices;
+
+	inline std::uint32_t drawnIndices() const { return stream ? streamedIndices.size() : indexCount; }
+	inline VkDeviceSize bufferMemory() const {
+		VkDeviceSize size = indexCapacity;
+		if(arena) size += arena->memory(range) + arena->memory(lodRange);
+		for(const VkDeviceSize capacity : vertexCapacities) size += capacity;
+		for(const VkDeviceSize capacity : meshArrayCapacities) size += capacity;
+		return size;
+	}
 };
-std::vector<Object> objects;
+std::list<Object> objects; // Never moved, the level of detail jobs keep their address
+
+// Meshes read by worker threads, they become objects once their parse is finished
+struct PendingObject {
+	std::string name;
+	std::future<LoadedMesh> mesh;
+};
+std::vector<PendingObject> pendingObjects;
 
 gfx::Instance instance;
 gfx::Window window;
@@ -43,9 +178,53 @@ gfx::Swapchain swapchain;
 gfx::DepthImage depthImage;
 gfx::RenderPass renderPass;
 gfx::DescriptorPool descriptorPool;
-gfx::Pipeline pipeline;
+gfx::StagingRing staging;
+// Geometry of the objects in the full and compact formats, each arena is drawn by a single indirect draw
+std::array<gfx::GeometryArena, 2> arenas;
+gfx::Pipeline pipeline, compactPipeline;
+// Vertex pulling pipelines for the mesh types of AnyMesh and the layout of their mesh arrays
+std::array<gfx::Pipeline, std::variant_size_v<AnyMesh>> pulledPipelines;
+gfx::StorageLayout meshArrayLayout;
+// Smooth normals of the pulled vertices: sums of the corners of each mesh type, then normalization
+std::array<gfx::ComputePipeline, std::variant_size_v<AnyMesh>> cornerNormalPipelines;
+gfx::ComputePipeline normalizePipeline;
 gfx::GUI gui;
-gfx::CommandBuffers cmdBuffs, uniCmdBuffs;
+gfx::CommandBuffers cmdBuffs;
+// Per swapchain image: ObjectConstants read by test.vert at the first instance of the draws, followed by the indirect
+// commands of the arenas. The host writes them when it records the frame.
+// With meshlet culling, the commands are written by cull.comp in `draws` from the CullObjects of `cull`, the host reads
+// back the counters of the previous submit of the frame then resets them. cullSets bind the meshlets of each arena.
+// `hidden` lists the meshlets tested again after the depth pyramid is built, their draws follow the others in `draws`.
+struct FrameObjects {
+	gfx::Buffer buffer;
+	gfx::StorageSet set;
+	std::size_t capacity = 0u;
+	gfx::Buffer cull, draws, hidden;
+	std::size_t cullCapacity = 0u, drawCapacity = 0u;
+	std::array<gfx::StorageSet, 2> cullSets;
+	std::array<std::uint64_t, 2> cullGenerations {};
+	std::uint32_t meshlets = 0u, cullObjects = 0u; // Meshlets and objects culled by the previous submit
+};
+std::vector<FrameObjects> frameObjects;
+gfx::StorageLayout frameObjectsLayout;
+// Meshlets of the arenas culled on the GPU when indirect draws can take their count from a buffer, the objects are
+// otherwise drawn whole
+bool gpu_culling = false;
+gfx::ComputePipeline cullPipeline;
+gfx::StorageLayout cullLayout;
+// Meshlets are also culled when hidden in the depth pyramid, if the depth image can be sampled
+bool hiz_culling = false;
+gfx::DepthPyramid pyramid;
+struct CullStats {
+	std::uint32_t meshlets, drawn, frustumCulled, backfaceCulled;
+	std::uint32_t occludedMeshlets, occludedObjects, occludedTriangles;
+} cull_stats {};
+// Triangles of the loaded objects at full resolution and the ones drawn after the choice of their levels and the culling
+struct TriangleStats {
+	std::uint32_t loaded, drawn;
+} triangle_stats {};
+// Objects are drawn at their coarsest level of detail whose error covers at most this many pixels
+constexpr float LOD_PIXEL_ERROR = 1.f;
 gfx::Semaphore imageAvailable[20], renderFinished[20];
 std::vector<gfx::Fence> cmdSubmitted;
 int currentFrame = 0;
@@ -68,6 +247,8 @@ struct Camera {
 	vec3f(0, zoom * float(width) / float(height), 0),
 	vec3f(0, 0, -1)
 };
+// Camera of the depth in the pyramid, none until a frame builds it
+std::optional<Camera> pyramid_cam;
 bool smooth_shading = false;
 
 //== Preferences ==//
@@ -78,8 +259,41 @@ std::vector<const char*> gpu_names;
 int chosenGPU = 0;
 const char* styles[] { "Light", "Dark", "Classic" };
 int &chosenStyle = Config::data.style;
+const char* precisions[] { "Double", "Float", "16 bits" };
+int &chosenPrecision = Config::data.mesh_precision;
+const char* vertex_formats[] { "Full (32 bytes)", "Compact (16 bytes)", "Mesh arrays" };
+int &chosenVertexFormat = Config::data.vertex_format;
 //=================//
 
+//== Open File ==//
+bool openFileRequested = false;
+char open_path[1024] = "";
+bool open_stream = false;
+//===============//
+
+//== Startup timing ==//
+// Timings of the startup and of the loads, printed by debug builds and by release builds given --timings
+#ifdef NDEBUG
+bool print_timings = false;
+#else
+bool print_timings = true;
+#endif
+Timer startup_timer, stage_timer;
+
+template<typename... Args>
+static void logTiming(const Args&... args) {
+	if(!print_timings) return;
+	std::cerr << "[timing]";
+	((std::cerr << ' ' << args), ...);
+	std::cerr << std::endl;
+}
+
+static void logStage(const char* stage) {
+	logTiming(stage, "in", 1e3 * stage_timer.elapsed(), "ms");
+	stage_timer.reset();
+}
+//====================//
+
 void initDevice();
 void cleanDevice();
 
@@ -87,6 +301,11 @@ static void openPreferences() {
 	preferenceOpened = !preferenceOpened;
 }
 
+static void clampPreferences() {
+	chosenPrecision = std::clamp(chosenPrecision, 0, int(std::size(precisions)) - 1);
+	chosenVertexFormat = std::clamp(chosenVertexFormat, 0, int(std::size(vertex_formats)) - 1);
+}
+
 static void setStyle() {
 	switch(chosenStyle) {
 		case 0: ImGui::StyleColorsLight(); break;
@@ -146,6 +365,9 @@ static void cursorPosCallback([[maybe_unused]] GLFWwindow *window, double xpos,
 static void keyCallback([[maybe_unused]] GLFWwindow *window, int key, [[maybe_unused]] int scancode, int action, int mods) {
 	if((mods & GLFW_MOD_CONTROL) && (action == GLFW_PRESS)) {
 		switch(key) {
+		case GLFW_KEY_O:
+			openFileRequested = true;
+			break;
 		case GLFW_KEY_P:
 			openPreferences();
 			break;
@@ -155,53 +377,530 @@ static void keyCallback([[maybe_unused]] GLFWwindow *window, int key, [[maybe_un
 	}
 }
 
-void fillVertexBuffer() {
-	if(smooth_shading) {
-		for(Object &obj : objects) {
-			std::vector<vec3> normals(obj.nverts(), vec3(0.));
-			for(std::uint32_t f = 0, fc = 0; f < obj.nfacets(); ++f) for(; fc < obj.facet_offset[f+1]; ++fc) {
-				const std::uint32_t pfc = obj.prev(f, fc);
-				const std::uint32_t nfc = obj.next(f, fc);
-				const vec3 a = obj.corner_point(pfc) - obj.corner_point(fc);
-				const vec3 b = obj.corner_point(nfc) - obj.corner_point(fc);
-				const vec3 normal = cross(a, b);
-				const double c = a * b;
-				const double s = normal.norm();
-				const double angle = std::atan2(s, c);
-				const std::uint32_t v = obj.facet_vertices[fc];
-				normals[v] += (angle / s) * normal;
-			}
-			for(vec3 &n : normals) n.normalize();
-
-			const VkDeviceSize size = sizeof(gfx::Vertex) * obj.nfacet_corners();
-			gfx::Buffer tmp = gfx::Buffer::createStagingBuffer(device, size);
-			gfx::Vertex* vmap = (gfx::Vertex*) tmp.mapMemory();
-			for(std::uint32_t f = 0, fc = 0; f < obj.nfacets(); ++f) for(; fc < obj.facet_offset[f+1]; ++fc) {
-				const std::uint32_t v = obj.facet_vertices[fc];
-				vmap[fc].pos = obj.points[v];
-				vmap[fc].normal = normals[v];
-				if(obj.facet_corner_attributes.empty()) vmap[fc].uv = vec2f(0.);
-				else vmap[fc].uv = obj.facet_corner_attributes[0].uv[fc];
-			}
-			// TODO: copy use submit OT that wait for the command to finish: No need for sync here
-			gfx::Buffer::copy(device, tmp, obj.vertexBuffer, size);
+// Free buffer once the uploads already recorded in the staging batch are done
+template<typename B>
+static void releaseBuffer(B &buffer, VkDeviceSize &capacity) {
+	if(capacity) staging.release(std::move(buffer));
+	capacity = 0u;
+}
+
+// Make room for `size` bytes in buffer, its first `keep` bytes are preserved.
+// Buffers growing by appending data get a geometric growth, the others are reallocated to the exact size.
+template<typename B>
+static void reserveBuffer(B &buffer, VkDeviceSize &capacity, const VkDeviceSize size, const VkDeviceSize keep = 0u) {
+	if(keep ? size <= capacity : size == capacity) return;
+	const VkDeviceSize newCapacity = keep ? std::max({ size, 2 * capacity, VkDeviceSize(1u << 20) }) : size;
+	B bigger;
+	bigger.init(device, newCapacity);
+	if(keep) staging.copy(buffer, bigger, keep);
+	releaseBuffer(buffer, capacity);
+	buffer = std::move(bigger);
+	capacity = newCapacity;
+}
+
+// Smooth normals of the mesh of obj, computed once then kept for the next uploads
+template<typename M>
+static const std::vector<vec3>& smoothNormals(Object &obj, const M &m) {
+	if(obj.smoothNormals.empty()) {
+		if(obj.vertexCorners.empty()) obj.vertexCorners = buildVertexCorners(m);
+		obj.smoothNormals = computeSmoothNormals(m, obj.vertexCorners);
+	}
+	return obj.smoothNormals;
+}
+
+// Fill buffer with the `size` bytes written by fill(void*) in the staging ring
+template<typename B, typename Fill>
+static void uploadBuffer(B &buffer, VkDeviceSize &capacity, const VkDeviceSize size, const Fill &fill) {
+	reserveBuffer(buffer, capacity, size);
+	fill(staging.stage(buffer, size));
+}
+
+// Fill the stream `stream` of obj in its arena with the values written by pack(T*) in the staging ring
+template<typename T, typename Pack>
+static void uploadStream(Object &obj, const gfx::VertexLayout::STREAM stream, const Pack &pack) {
+	pack(static_cast<T*>(obj.arena->stageVertices(obj.range, stream)));
+}
+
+// Fill the stream `stream` of obj with the compact values of the values written by pack(T*),
+// they are converted in parallel by encode(const T*, n, E*)
+template<typename T, typename E, typename Pack, typename Encode>
+static void uploadEncodedStream(Object &obj, const gfx::VertexLayout::STREAM stream, const Pack &pack, const Encode &encode) {
+	const std::size_t count = obj.range.vertexCount;
+	std::vector<T> values(count);
+	pack(values.data());
+	uploadStream<E>(obj, stream, [&](E* out) {
+		parallelRanges(count, [&](std::size_t, const std::size_t begin, const std::size_t end) {
+			encode(values.data() + begin, end - begin, out + begin);
+		});
+	});
+}
+
+// Fill the array `array` of obj with the `size` bytes written by fill(void*), empty arrays have no buffer
+template<typename Fill>
+static void uploadMeshArray(Object &obj, const MeshArray array, const VkDeviceSize size, const Fill &fill) {
+	if(!size) {
+		releaseBuffer(obj.meshArrays[array], obj.meshArrayCapacities[array]);
+		return;
+	}
+	uploadBuffer(obj.meshArrays[array], obj.meshArrayCapacities[array], size, fill);
+}
+
+static void uploadMeshArray(Object &obj, const MeshArray array, const void* data, const VkDeviceSize size) {
+	uploadMeshArray(obj, array, size, [&](void* out) { std::memcpy(out, data, size); });
+}
+
+// Bind the arrays of obj to its descriptor set, the points stand for the empty arrays which are never read
+static void updateMeshArraySet(Object &obj) {
+	VkBuffer buffers[MESH_ARRAY_COUNT];
+	for(unsigned i = 0; i < MESH_ARRAY_COUNT; ++i)
+		buffers[i] = obj.meshArrayCapacities[i] ? obj.meshArrays[i] : obj.meshArrays[POINTS];
+	obj.meshArraySet.init(device, meshArrayLayout, buffers);
+}
+
+// Upload the arrays of m as they are stored, converting only the points and texture coordinates stored in double precision
+template<typename M>
+static void fillMeshArrays(Object &obj, const M &m) {
+	std::vector<vec3f> converted;
+	uploadMeshArray(obj, POINTS, m.floatPoints(converted), sizeof(vec3f) * m.nverts());
+	uploadMeshArray(obj, FACET_VERTICES, m.facet_vertices.data(), sizeof(std::uint32_t) * m.nfacet_corners());
+	if constexpr(M::ARITY == 0) uploadMeshArray(obj, FACET_OFFSET, m.facet_offset.data(), sizeof(std::uint32_t) * m.facet_offset.size());
+	else uploadMeshArray(obj, FACET_OFFSET, nullptr, 0u);
+
+	const Attribute* uv = m.facet_corner_attributes.empty() ? nullptr : &m.facet_corner_attributes[0];
+	const std::size_t nuvs = uv ? std::min(uv->size(), m.nfacet_corners()) : 0u;
+	if(uv && uv->type == Attribute::FLOAT_VEC2) uploadMeshArray(obj, CORNER_UVS, uv->uvf.data(), sizeof(vec2f) * nuvs);
+	else uploadMeshArray(obj, CORNER_UVS, sizeof(vec2f) * nuvs, [&](void* out) {
+		parallelFor(nuvs, [&](const std::size_t fc) { ((vec2f*) out)[fc] = uv->vec2_at(fc); });
+	});
+	// Room for the smooth normals, computed on the first use. The set is not updated then, the frames in flight use it.
+	reserveBuffer(obj.meshArrays[VERTEX_NORMALS], obj.meshArrayCapacities[VERTEX_NORMALS], sizeof(vec3f) * m.nverts());
+	obj.vertexNormalsReady = false;
+	updateMeshArraySet(obj);
+	obj.constants = { vec3f(0.f), vec3f(1.f, 1.f, 1.f), std::uint32_t(m.nfacets()), std::uint32_t(nuvs), 0u };
+}
+
+// Record in cmd the computation of the smooth normals of the pulled vertices of obj, before the draws of the frame.
+// The points and facets must be uploaded, the frame acquires them.
+static void recordVertexNormals(gfx::CommandBuffer &cmd, Object &obj) {
+	// Every invocation loops over the items, the group count stays under the minimal limit of Vulkan
+	const auto groups = [](const std::uint32_t count) { return std::min((count + 63u) / 64u, 65535u); };
+	const std::uint32_t nfacets = obj.constants.nfacets;
+	const std::uint32_t nverts = std::visit([](const auto &m) { return std::uint32_t(m.nverts()); }, obj.mesh);
+	cmd
+		.fillBuffer(obj.meshArrays[VERTEX_NORMALS], 0u, VK_WHOLE_SIZE, 0u)
+		.memoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+		.bindPipeline(cornerNormalPipelines[obj.mesh.index()])
+		.bindDescriptorSet(cornerNormalPipelines[obj.mesh.index()], obj.meshArraySet)
+		.pushConstants(cornerNormalPipelines[obj.mesh.index()], sizeof(nfacets), &nfacets)
+		.dispatch(groups(nfacets))
+		.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+		.bindPipeline(normalizePipeline)
+		.bindDescriptorSet(normalizePipeline, obj.meshArraySet)
+		.pushConstants(normalizePipeline, sizeof(nverts), &nverts)
+		.dispatch(groups(nverts))
+		.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+// Free the ranges of obj in its arena, the draws using them must be done
+static void releaseRange(Object &obj) {
+	if(obj.arena) {
+		obj.arena->free(obj.range);
+		obj.arena->free(obj.lodRange);
+	}
+	obj.arena = nullptr;
+}
+
+// Free the buffers that the vertex format of obj does not use, the vertices of a finished mesh are never streamed
+static void releaseUnusedBuffers(Object &obj) {
+	releaseRange(obj);
+	for(std::size_t i = 0; i < obj.vertexBuffers.size(); ++i) releaseBuffer(obj.vertexBuffers[i], obj.vertexCapacities[i]);
+	if(obj.format != VertexFormat::PULLED) {
+		releaseBuffer(obj.indexBuffer, obj.indexCapacity);
+		obj.meshArraySet.clean();
+		for(std::size_t i = 0; i < obj.meshArrays.size(); ++i) releaseBuffer(obj.meshArrays[i], obj.meshArrayCapacities[i]);
+	}
+}
+
+// Whether the vertices of m in an arena are its points, the corners of a point then share its vertex and the range
+// needs about 6 times fewer vertices on triangle meshes. Facet corner attributes differ between the corners of a point,
+// so that the vertices are the corners otherwise. The choice does not depend on the shading: point vertices hold the
+// smooth normals and test.frag derives the flat ones.
+template<typename M>
+static bool usePointVertices(const M &m) {
+	return m.facet_corner_attributes.empty();
+}
+
+// Upload the normal stream of obj in its vertex format, the smooth normals of the points or the normals of the corners
+// for the current shading
+template<typename M>
+static void uploadNormals(Object &obj, const M &m) {
+	const auto pack = [&](vec3f* out) {
+		if(obj.pointVertices) simd::convertPoints(smoothNormals(obj, m).data(), nullptr, m.nverts(), out);
+		else if(smooth_shading) packSmoothNormals(m, smoothNormals(obj, m), 0, m.nfacets(), out);
+		else packFlatNormals(m, 0, m.nfacets(), out);
+	};
+	if(obj.format == VertexFormat::COMPACT) uploadEncodedStream<vec3f, snorm16x2>(obj, gfx::VertexLayout::NORMAL, pack, encodeNormals);
+	else uploadStream<vec3f>(obj, gfx::VertexLayout::NORMAL, pack);
+	obj.uploaded = staging.currentToken();
+}
+
+// Stage the triangles and meshlets of g in range of the arena of obj. The triangles are given by their corners, point
+// vertices are indexed by the points of the corners.
+template<typename M>
+static void stageGeometry(Object &obj, const M &m, const gfx::GeometryArena::Range &range, const RangeGeometry &g) {
+	std::uint32_t* indices = static_cast<std::uint32_t*>(obj.arena->stageIndices(range));
+	if(obj.pointVertices) parallelFor(g.indices.size(), [&](const std::size_t i) { indices[i] = m.facet_vertices[g.indices[i]]; });
+	else std::memcpy(indices, g.indices.data(), sizeof(std::uint32_t) * g.indices.size());
+	std::memcpy(obj.arena->stageMeshlets(range), g.meshlets.data(), sizeof(Meshlet) * g.meshlets.size());
+}
+
+// Stage the levels of detail of obj built so far in a range of its arena, after the one of its vertices
+template<typename M>
+static void uploadLods(Object &obj, const M &m) {
+	if(obj.lods.indices.empty()) return;
+	obj.lodRange = obj.arena->allocate(0u, obj.lods.indices.size(), obj.lods.meshlets.size());
+	stageGeometry(obj, m, obj.lodRange, obj.lods);
+	obj.lodsUploaded = staging.currentToken();
+}
+
+// Update the normals of obj for the current shading, the other streams do not depend on it.
+// Pulled vertices only need the smooth normals of the points, computed on the GPU once and kept while flat shaded,
+// flat normals are computed by the vertex shader. Point vertices keep their smooth normals, only their constants change.
+void fillNormalBuffer(Object &obj) {
+	if(obj.stream || !obj.indexCount) return;
+	obj.constants.smoothNormals = smooth_shading;
+	std::visit([&](const auto &m) {
+		if(obj.format == VertexFormat::PULLED) {
+			if(smooth_shading && !obj.vertexNormalsReady) obj.vertexNormalsPending = true;
+		} else if(!obj.pointVertices) uploadNormals(obj, m);
+	}, obj.mesh);
+}
+
+// Upload the triangles of obj and its vertex data in the chosen vertex format, a vertex per corner or per point
+void fillVertexBuffer(Object &obj) {
+	if(obj.stream) return;
+	obj.format = VertexFormat(chosenVertexFormat);
+	releaseUnusedBuffers(obj);
+	std::visit([&](const auto &m) {
+		const RangeGeometry &g = obj.geometry;
+		obj.indexCount = g.levels.empty() ? 0u : g.levels[0].indexCount;
+		obj.pointVertices = usePointVertices(m);
+		if(!obj.indexCount) return;
+		const auto packPoints = [&](vec3f* out) {
+			if(!obj.pointVertices) packPositions(m, 0, m.nfacets(), out);
+			else if(m.precision() == Precision::DOUBLE) simd::convertPoints(m.points.data(), nullptr, m.nverts(), out);
+			else parallelFor(m.nverts(), [&](const std::size_t v) { out[v] = m.point(v); });
+		};
+		const auto packCoordinates = [&](vec2f* out) {
+			if(obj.pointVertices) std::fill_n(out, m.nverts(), vec2f(0.f, 0.f));
+			else packUVs(m, 0, m.nfacets(), out);
+		};
+		if(obj.format == VertexFormat::PULLED) {
+			// Full resolution only, in the order of its meshlets
+			const VkDeviceSize indexSize = sizeof(std::uint32_t) * obj.indexCount;
+			fillMeshArrays(obj, m);
+			reserveBuffer(obj.indexBuffer, obj.indexCapacity, indexSize);
+			staging.upload(obj.indexBuffer, g.indices.data(), indexSize);
+			return;
 		}
-	} else {
-		for(Object &obj : objects) {
-			const VkDeviceSize size = sizeof(gfx::Vertex) * obj.nfacet_corners();
-			gfx::Buffer tmp = gfx::Buffer::createStagingBuffer(device, size);
-			gfx::Vertex* vmap = (gfx::Vertex*) tmp.mapMemory();
-			for(std::uint32_t f = 0, fc = 0; f < obj.nfacets(); ++f) for(; fc < obj.facet_offset[f+1]; ++fc) {
-				const std::uint32_t v = obj.facet_vertices[fc];
-				vmap[fc].pos = obj.points[v];
-				vmap[fc].normal = obj.corner_normal(f, fc);
-				if(obj.facet_corner_attributes.empty()) vmap[fc].uv = vec2f(0.);
-				else vmap[fc].uv = obj.facet_corner_attributes[0].uv[fc];
-			}
-			// TODO: copy use submit OT that wait for the command to finish: No need for sync here
-			gfx::Buffer::copy(device, tmp, obj.vertexBuffer, size);
+		obj.arena = &arenas[obj.format == VertexFormat::COMPACT];
+		obj.range = obj.arena->allocate(obj.pointVertices ? m.nverts() : m.nfacet_corners(), g.indices.size(), g.meshlets.size());
+		if(obj.format == VertexFormat::COMPACT) {
+			const Quantization q = quantization(m);
+			obj.constants = { q.origin, q.extent };
+			uploadEncodedStream<vec3f, unorm16x4>(obj, gfx::VertexLayout::POSITION, packPoints,
+				[&](const vec3f* in, const std::size_t k, unorm16x4* out) { encodePositions(in, k, q, out); });
+			uploadEncodedStream<vec2f, half2>(obj, gfx::VertexLayout::UV, packCoordinates, encodeUVs);
+		} else {
+			obj.constants = { vec3f(0.f), vec3f(1.f, 1.f, 1.f) };
+			uploadStream<vec3f>(obj, gfx::VertexLayout::POSITION, packPoints);
+			uploadStream<vec2f>(obj, gfx::VertexLayout::UV, packCoordinates);
 		}
+		// Point vertices hold the smooth normals whatever the shading, fillNormalBuffer uploads the ones of corner vertices
+		obj.constants.pointVertices = obj.pointVertices;
+		if(obj.pointVertices) uploadNormals(obj, m);
+		stageGeometry(obj, m, obj.range, g);
+		uploadLods(obj, m);
+	}, obj.mesh);
+	fillNormalBuffer(obj);
+	obj.uploaded = staging.currentToken();
+}
+
+void fillVertexBuffers() {
+	for(Object &obj : objects) fillVertexBuffer(obj);
+}
+
+void fillNormalBuffers() {
+	for(Object &obj : objects) fillNormalBuffer(obj);
+}
+
+// Upload data[first, end) after the `first` elements already in buffer
+template<typename T, typename B>
+static void uploadAppended(B &buffer, VkDeviceSize &capacity, std::vector<T> &data, const std::size_t first) {
+	const VkDeviceSize offset = sizeof(T) * first;
+	const VkDeviceSize size = sizeof(T) * data.size();
+	if(size == offset) return;
+	reserveBuffer(buffer, capacity, size, offset);
+	staging.upload(buffer, data.data() + first, size - offset, offset);
+}
+
+// Upload the streamed data of obj from the vertex `firstVertex` and the index `firstIndex`, growing its buffers if needed
+static void uploadStreamedData(Object &obj, const std::size_t firstVertex, const std::size_t firstIndex) {
+	uploadAppended(obj.vertexBuffers[gfx::VertexLayout::POSITION], obj.vertexCapacities[gfx::VertexLayout::POSITION], obj.streamedPositions, firstVertex);
+	uploadAppended(obj.vertexBuffers[gfx::VertexLayout::NORMAL], obj.vertexCapacities[gfx::VertexLayout::NORMAL], obj.streamedNormals, firstVertex);
+	uploadAppended(obj.vertexBuffers[gfx::VertexLayout::UV], obj.vertexCapacities[gfx::VertexLayout::UV], obj.streamedUVs, firstVertex);
+	uploadAppended(obj.indexBuffer, obj.indexCapacity, obj.streamedIndices, firstIndex);
+	obj.uploaded = staging.currentToken();
+}
+
+// Allocate the buffers of obj and fill them with what is available of its mesh
+static void initBuffers(Object &obj) {
+	if(obj.stream) uploadStreamedData(obj, 0, 0);
+	else fillVertexBuffer(obj);
+}
+
+static Object& addObject(const std::string &name) {
+	Object &obj = objects.emplace_back();
+	obj.name = name;
+	std::fill_n(obj.surfaceColor, 3, 0.65f);
+	return obj;
+}
+
+// Triangles of the full resolution of m, the single level of its range. Meshlets reorder the triangles, so that each
+// one covers a contiguous range of indices.
+template<typename M>
+static RangeGeometry buildRangeGeometry(const M &m) {
+	Timer timer;
+	RangeGeometry res;
+	res.indices = triangulateFacets(m, 0, m.nfacets());
+	if(res.indices.empty()) return res;
+	res.meshlets = buildMeshlets(m, res.indices);
+	res.levels = { { 0u, std::uint32_t(res.indices.size()), 0u, std::uint32_t(res.meshlets.size()), 0.f } };
+	logTiming(res.meshlets.size(), "meshlets built in", 1e3 * timer.elapsed(), "ms");
+	return res;
+}
+
+// Coarser levels of detail of m from the triangles of its full resolution, one after the other with their own meshlets,
+// meshlets of every level index from the start of their range.
+template<typename M>
+static RangeGeometry buildLodGeometry(const M &m, const std::vector<std::uint32_t> &indices) {
+	Timer timer;
+	RangeGeometry res;
+	for(Lod &lod : buildLods(m, indices)) {
+		std::vector<Meshlet> lodMeshlets = buildMeshlets(m, lod.indices);
+		const RangeGeometry::Level level { std::uint32_t(res.indices.size()), std::uint32_t(lod.indices.size()),
+			std::uint32_t(res.meshlets.size()), std::uint32_t(lodMeshlets.size()), lod.error };
+		for(Meshlet &meshlet : lodMeshlets) meshlet.firstIndex += level.firstIndex;
+		res.indices.insert(res.indices.end(), lod.indices.begin(), lod.indices.end());
+		res.meshlets.insert(res.meshlets.end(), lodMeshlets.begin(), lodMeshlets.end());
+		res.levels.push_back(level);
 	}
+	logTiming(res.levels.size(), "levels of detail and", res.meshlets.size(), "meshlets built in", 1e3 * timer.elapsed(), "ms");
+	return res;
+}
+
+// Build the levels of detail of obj in a worker thread, they are uploaded by updateLods once built
+static void buildLodsLater(Object &obj) {
+	if(obj.geometry.indices.empty()) return;
+	obj.lodJob = std::async(std::launch::async, [&obj]() {
+		const ThreadShare share;
+		return std::visit([&](const auto &m) { return buildLodGeometry(m, obj.geometry.indices); }, obj.mesh);
+	});
+}
+
+// Specialize a mesh that has just been read, move it in the chosen storage and build its full resolution, the levels of
+// detail are built once it is staged. Called by worker threads, the render thread only stages the result.
+static LoadedMesh prepareMesh(Mesh &&m, const Precision precision) {
+	LoadedMesh res { specializeMesh(std::move(m)) };
+	std::visit([&](auto &mesh) {
+		mesh.setPrecision(precision);
+		res.geometry = buildRangeGeometry(mesh);
+		if(usePointVertices(mesh)) res.smoothNormals = computeSmoothNormals(mesh);
+	}, res.mesh);
+	return res;
+}
+
+// Start reading a mesh file without blocking the frame loop, the files read at the same time share the hardware threads
+static void openMesh(const std::string &path, const bool stream) {
+	const std::string name = std::filesystem::path(path).filename().replace_extension();
+	const Precision precision = Precision(chosenPrecision);
+	if(stream) addObject(name).stream = std::make_unique<MeshStream>(path);
+	else pendingObjects.push_back({ name, std::async(std::launch::async, [path, precision]() {
+		const ThreadShare share;
+		return prepareMesh(readMesh(path.c_str()), precision);
+	}) });
+}
+
+// Move the loaded meshes in the chosen storage, the vertices are uploaded again. The level of detail jobs reading them
+// must be done, their levels do not depend on the precision.
+static void setMeshPrecision() {
+	device.waitIdle();
+	for(Object &obj : objects) if(!obj.stream) {
+		if(obj.lodJob.valid()) obj.lodJob.wait();
+		std::visit([](auto &mesh) { mesh.setPrecision(Precision(chosenPrecision)); }, obj.mesh);
+		obj.smoothNormals.clear();
+	}
+	fillVertexBuffers();
+	staging.finish();
+}
+
+// Upload the meshes again in the chosen vertex format, meshes being streamed switch once they are finished
+static void setVertexFormat() {
+	device.waitIdle();
+	fillVertexBuffers();
+	staging.finish();
+}
+
+// Move the buffers out of the memory blocks that unloaded objects left sparse, so that the allocator releases them
+static void defragmentMemory() {
+	Timer timer;
+	gfx::MemoryAllocator &allocator = device.getAllocator();
+	const std::uint32_t blocks = allocator.beginDefragmentation();
+	if(blocks) for(gfx::GeometryArena &arena : arenas) arena.relocate();
+	if(blocks) for(Object &obj : objects) {
+		for(gfx::VertexBuffer &buffer : obj.vertexBuffers) buffer.relocate();
+		obj.indexBuffer.relocate();
+		bool moved = false;
+		for(gfx::StorageBuffer &buffer : obj.meshArrays) moved |= buffer.relocate();
+		if(moved) updateMeshArraySet(obj);
+	}
+	allocator.endDefragmentation();
+	if(blocks) logTiming(blocks, "memory blocks evacuated in", 1e3 * timer.elapsed(), "ms");
+}
+
+// Free the buffers of the object at it then compact the memory of the others, waiting for its level of detail job
+static void unloadObject(const std::list<Object>::iterator it) {
+	staging.finish();
+	device.waitIdle();
+	releaseRange(*it);
+	objects.erase(it);
+	defragmentMemory();
+}
+
+// Turn the finished parses into objects, their vertex buffers are uploaded right away and they are drawn once uploaded
+static void updatePendingObjects() {
+	for(auto it = pendingObjects.begin(); it != pendingObjects.end();) {
+		if(it->mesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++ it;
+			continue;
+		}
+		try {
+			LoadedMesh loaded = it->mesh.get();
+			Timer timer;
+			Object &obj = addObject(it->name);
+			obj.mesh = std::move(loaded.mesh);
+			obj.geometry = std::move(loaded.geometry);
+			obj.smoothNormals = std::move(loaded.smoothNormals);
+			initBuffers(obj);
+			buildLodsLater(obj);
+			logTiming(obj.name, "staged in", 1e3 * timer.elapsed(), "ms,",
+						1e3 * startup_timer.elapsed(), "ms after startup");
+		} catch(const std::exception &e) {
+			std::cerr << "Failed to load " << it->name << ": " << e.what() << std::endl;
+		}
+		it = pendingObjects.erase(it);
+	}
+}
+
+// Receive the chunks sent by the loader threads, the new facets are drawn from the next frame
+static void updateStreams() {
+	struct Update {
+		Object *obj;
+		std::size_t firstVertex, firstIndex;
+		bool finished;
+	};
+	std::vector<Update> updates;
+	MeshStream::Chunk chunk;
+	for(Object &obj : objects) if(obj.stream) {
+		if(obj.prepared.valid()) {
+			if(obj.prepared.wait_for(std::chrono::seconds(0)) == std::future_status::ready) updates.push_back({ &obj, 0, 0, true });
+			continue;
+		}
+		// Check finished first so that no chunk can arrive after the queue is drained
+		const bool finished = obj.stream->finished();
+		const std::size_t firstVertex = obj.streamedPositions.size();
+		const std::size_t firstIndex = obj.streamedIndices.size();
+		while(obj.stream->pop(chunk)) {
+			obj.streamedPositions.insert(obj.streamedPositions.end(), chunk.positions.begin(), chunk.positions.end());
+			obj.streamedNormals.insert(obj.streamedNormals.end(), chunk.normals.begin(), chunk.normals.end());
+			obj.streamedUVs.insert(obj.streamedUVs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			obj.streamedIndices.insert(obj.streamedIndices.end(), chunk.indices.begin(), chunk.indices.end());
+		}
+		// The finished mesh is prepared by a worker thread, the stream outlives it since the future is destroyed first
+		if(finished) obj.prepared = std::async(std::launch::async, [&stream = *obj.stream, precision = Precision(chosenPrecision)]() {
+			const ThreadShare share;
+			return prepareMesh(stream.takeMesh(), precision);
+		});
+		if(obj.streamedPositions.size() > firstVertex) updates.push_back({ &obj, firstVertex, firstIndex, false });
+	}
+	if(updates.empty()) return;
+
+	// Grown buffers are released once the frames using them are done. Finished meshes move to their arena range and
+	// release the streamed buffers the same way, the frames in flight keep drawing them.
+	for(const Update &u : updates) {
+		Object &obj = *u.obj;
+		if(!u.finished) {
+			uploadStreamedData(obj, u.firstVertex, u.firstIndex);
+			continue;
+		}
+		try {
+			LoadedMesh loaded = obj.prepared.get();
+			obj.mesh = std::move(loaded.mesh);
+			obj.geometry = std::move(loaded.geometry);
+			obj.smoothNormals = std::move(loaded.smoothNormals);
+			// The precision may have been changed while the mesh was prepared
+			std::visit([](auto &mesh) { mesh.setPrecision(Precision(chosenPrecision)); }, obj.mesh);
+		} catch(const std::exception &e) {
+			std::cerr << "Failed to load " << obj.name << ": " << e.what() << std::endl;
+		}
+		obj.stream.reset();
+		obj.indexCount = obj.streamedIndices.size();
+		obj.streamedPositions = {};
+		obj.streamedNormals = {};
+		obj.streamedUVs = {};
+		obj.streamedIndices = {};
+		// Pulled vertices would otherwise write their facets in the index buffer being drawn
+		releaseBuffer(obj.indexBuffer, obj.indexCapacity);
+		fillVertexBuffer(obj);
+		buildLodsLater(obj);
+		obj.streamFinished = true;
+	}
+}
+
+// Take the levels of detail built since the last frame and stage them, objects drawn with pulled vertices keep them for
+// their next upload to an arena
+static void updateLods() {
+	for(Object &obj : objects) {
+		if(!obj.lodJob.valid() || obj.lodJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+		try {
+			obj.lods = obj.lodJob.get();
+			if(obj.arena) std::visit([&](const auto &m) { uploadLods(obj, m); }, obj.mesh);
+		} catch(const std::exception &e) {
+			std::cerr << "Failed to build the levels of detail of " << obj.name << ": " << e.what() << std::endl;
+		}
+	}
+}
+
+// Level of detail of obj drawn in the frame, 0 for the full resolution and l for lods.levels[l - 1]. The camera is
+// orthographic and a unit spans |u| = zoom half widths of the window, so the error of a level covers the same number
+// of pixels wherever the object is. The coarser levels are drawn once their upload up to the token ready is done.
+static std::size_t drawnLevel(const Object &obj, const gfx::UploadToken ready) {
+	const float pixels = 0.5f * float(width) * cam.u.norm();
+	const std::size_t count = obj.lodRange && obj.lodsUploaded <= ready ? obj.lods.levels.size() : 0u;
+	std::size_t level = 0;
+	while(level < count && obj.lods.levels[level].error * pixels <= LOD_PIXEL_ERROR) ++ level;
+	return level;
+}
+
+// Level of detail l of obj in an arena, relative to levelRange(obj, l)
+static inline const RangeGeometry::Level& objectLevel(const Object &obj, const std::size_t l) {
+	return l ? obj.lods.levels[l - 1] : obj.geometry.levels[0];
+}
+static inline const gfx::GeometryArena::Range& levelRange(const Object &obj, const std::size_t l) {
+	return l ? obj.lodRange : obj.range;
 }
 
 template<typename Fun>
@@ -232,8 +931,7 @@ static bool drawImGui() {
 	if(ImGui::BeginMainMenuBar()) {
 		if(ImGui::BeginMenu("File")) {
 			if(ImGui::MenuItem("Open", "Ctrl+O")) {
-				// TODO: Open mesh file (support shortcut)
-				PRINT_INFO("NOT IMPLEMENTED");
+				openFileRequested = true;
 			}
 			ImGui::Separator();
 			if(ImGui::MenuItem("Preferences", "Ctrl+P")) {
@@ -247,12 +945,60 @@ static bool drawImGui() {
 		}
 		ImGui::Separator();
 		ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Separator();
+		VkDeviceSize meshMemory = 0u;
+		for(const Object &obj : objects) meshMemory += obj.bufferMemory();
+		ImGui::Text("Mesh buffers: %.1f MiB", meshMemory / double(1u << 20));
+		if(ImGui::IsItemHovered()) {
+			ImGui::BeginTooltip();
+			for(const gfx::MemoryStats &stats : device.getAllocator().stats())
+				ImGui::Text("Memory type %u (%s): %u blocks, %.1f / %.1f MiB in %u allocations, %.0f%% fragmented",
+					stats.memoryType, stats.properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ? "device" : "host",
+					stats.blocks, stats.used / double(1u << 20), stats.reserved / double(1u << 20), stats.allocations,
+					100. * stats.fragmentation());
+			ImGui::EndTooltip();
+		}
+		if(gpu_culling) {
+			ImGui::Separator();
+			ImGui::Text("Meshlets: %u / %u drawn", cull_stats.drawn, cull_stats.meshlets);
+			if(ImGui::IsItemHovered()) ImGui::SetTooltip("%u off screen, %u facing away, %u occluded",
+				cull_stats.frustumCulled, cull_stats.backfaceCulled, cull_stats.occludedMeshlets);
+			if(hiz_culling) {
+				ImGui::Separator();
+				ImGui::Text("Occluded: %u objects, %u triangles", cull_stats.occludedObjects, cull_stats.occludedTriangles);
+			}
+		}
+		ImGui::Separator();
+		ImGui::Text("Triangles: %u / %u drawn", triangle_stats.drawn, triangle_stats.loaded);
+		if(ImGui::IsItemHovered()) ImGui::SetTooltip("Loaded triangles at full resolution, drawn after the choice of the levels of detail%s",
+			gpu_culling ? " and the culling" : "");
 		ImGui::EndMainMenuBar();
 	}
 
+	// The popup is opened here since menu items do not share its ID stack
+	if(openFileRequested) {
+		ImGui::OpenPopup("Open Mesh");
+		openFileRequested = false;
+	}
+	if(ImGui::BeginPopupModal("Open Mesh", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+		if(ImGui::IsWindowAppearing()) ImGui::SetKeyboardFocusHere();
+		bool open = ImGui::InputText("Path", open_path, sizeof(open_path), ImGuiInputTextFlags_EnterReturnsTrue);
+		ImGui::Checkbox("Display while reading", &open_stream);
+		open |= ImGui::Button("Open");
+		if(open && open_path[0]) {
+			openMesh(open_path, open_stream);
+			ImGui::CloseCurrentPopup();
+		}
+		ImGui::SameLine();
+		if(ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
+		ImGui::EndPopup();
+	}
+
 	if(preferenceOpened) {
 		if(ImGui::Begin("Preferences", &preferenceOpened)) {
 			myCombo("Style", std::size(styles), styles, chosenStyle, setStyle);
+			myCombo("Mesh Precision", std::size(precisions), precisions, chosenPrecision, setMeshPrecision);
+			myCombo("Vertex Format", std::size(vertex_formats), vertex_formats, chosenVertexFormat, setVertexFormat);
 			myCombo("GPU", gpus.size(), gpu_names.data(), chosenGPU, [&](){ draw = false; });
 			ImGui::Separator();
 			if(ImGui::Button("Save")) {
@@ -265,8 +1011,14 @@ static bool drawImGui() {
 			}
 			ImGui::SameLine();
 			if(ImGui::Button("Reload")) {
+				const int precision = chosenPrecision, vertexFormat = chosenVertexFormat;
 				Config::load();
 				setStyle();
+				clampPreferences();
+				// The loaded meshes follow the reloaded storage and vertex format like when they are chosen in the combos,
+				// a new precision already uploads them again in the chosen format
+				if(chosenPrecision != precision) setMeshPrecision();
+				else if(chosenVertexFormat != vertexFormat) setVertexFormat();
 				for(int i = 0; i < (int) gpus.size(); ++i)
 					if(i != chosenGPU && !strcmp(gpu_names[i], Config::data.preferred_gpu)) {
 						chosenGPU = i;
@@ -278,64 +1030,371 @@ static bool drawImGui() {
 		ImGui::End();
 	}
 
-	for(Object &obj :objects) {
+	auto unloaded = objects.end();
+	for(auto it = objects.begin(); it != objects.end(); ++it) {
+		Object &obj = *it;
 		if(ImGui::Begin((obj.name + " properties").c_str())) {
-			if(ImGui::Checkbox("Smooth Shading", &smooth_shading)) fillVertexBuffer();
+			if(ImGui::Checkbox("Smooth Shading", &smooth_shading)) {
+				// Only the normals of corner vertices change, they are written in place so the frames drawing them must be
+				// done. Pulled vertices compute theirs in the next frame on the first use, then like point vertices they
+				// only get new constants, without waiting for the GPU.
+				const bool inPlace = std::ranges::any_of(objects, [](const Object &o) {
+					return o.arena && o.indexCount && !o.pointVertices;
+				});
+				if(inPlace) device.waitIdle();
+				fillNormalBuffers();
+				if(inPlace) staging.finish();
+			}
 			ImGui::ColorEdit3("Surface Color", obj.surfaceColor);
+			const std::size_t corners = obj.stream ? obj.streamedPositions.size()
+				: std::visit([](const auto &m) { return m.nfacet_corners(); }, obj.mesh);
+			ImGui::Text("Buffers: %.2f MiB, %.1f bytes per corner%s", obj.bufferMemory() / double(1u << 20),
+				corners ? obj.bufferMemory() / double(corners) : 0., staging.isComplete(obj.uploaded) ? "" : " (uploading)");
+			if(obj.arena) {
+				const std::size_t l = drawnLevel(obj, staging.readyToken());
+				ImGui::Text("Level of detail: %u / %u, %u triangles%s", unsigned(l), unsigned(obj.lods.levels.size()),
+					objectLevel(obj, l).indexCount / 3u, obj.lodJob.valid() ? " (building levels)" : "");
+			}
+			if(ImGui::Button("Unload")) unloaded = it;
 		}
 		ImGui::End();
 	}
+	if(unloaded != objects.end()) unloadObject(unloaded);
 
 	ImGui::Render();
 	return draw;
 }
 
-void initCmdBuffs() {
-	//TODO: If we record command buffers for every frame then use push constants
-	cmdBuffs.resize(renderPass.size());
-	for(std::size_t i = 0; i < cmdBuffs.size(); ++i) {
-		cmdBuffs[i].begin()
-			.beginRenderPass(renderPass, swapchain, i)
-				.bindPipeline(pipeline)
-				.setViewport(swapchain.getExtent())
-				.bindDescriptorSet(pipeline, descriptorPool[i]);
-				for(const Object &obj : objects) cmdBuffs[i]
-					.bindVertexBuffer(obj.vertexBuffer)
-					.draw(obj.nfacet_corners(), 1, 0, 0);
-		cmdBuffs[i].endRenderPass().end();
+// Pipeline drawing obj, according to its vertex format
+static const gfx::Pipeline& objectPipeline(const Object &obj) {
+	switch(obj.format) {
+		case VertexFormat::COMPACT: return compactPipeline;
+		case VertexFormat::PULLED: return pulledPipelines[obj.mesh.index()];
+		default: return pipeline;
 	}
 }
 
+// Constants of obj in the frame, with the surface color chosen in its window
+static ObjectConstants drawnConstants(const Object &obj) {
+	ObjectConstants constants = obj.constants;
+	constants.color = vec3f(obj.surfaceColor[0], obj.surfaceColor[1], obj.surfaceColor[2]);
+	return constants;
+}
+
+// Record the draws of the frame i, objects are drawn once their uploads up to the token ready are done.
+// Returns the semaphore of these uploads, waited by the submit.
+static gfx::SemaphoreSubmit recordCmdBuff(const std::size_t i, const gfx::UploadToken ready) {
+	// The previous submit of the frame is done, its objects can be rewritten or reallocated
+	FrameObjects &frame = frameObjects[i];
+	const std::size_t count = std::ranges::count_if(objects, [](const Object &obj) { return obj.format != VertexFormat::PULLED; });
+	if(count > frame.capacity) {
+		frame.capacity = std::max({ count, 2u * frame.capacity, std::size_t(64u) });
+		frame.buffer.init(device, (sizeof(ObjectConstants) + sizeof(VkDrawIndexedIndirectCommand)) * frame.capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		const VkBuffer buffer = frame.buffer;
+		frame.set.init(device, frameObjectsLayout, &buffer);
+	}
+	ObjectConstants* constants = static_cast<ObjectConstants*>(frame.buffer.mapMemory());
+	VkDrawIndexedIndirectCommand* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(constants + frame.capacity);
+	std::uint32_t drawn = 0u;
+
+	// Counters of the previous submit of the frame, then reset for this one
+	CullObject* cullObjects = nullptr;
+	std::uint32_t arenaTriangles = 0u;
+	if(gpu_culling) {
+		if(!frame.cullCapacity || count > frame.cullCapacity) {
+			frame.cullCapacity = std::max({ count, 2u * frame.cullCapacity, std::size_t(64u) });
+			frame.cull.init(device, sizeof(CullCounters) + sizeof(CullObject) * frame.cullCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			*static_cast<CullCounters*>(frame.cull.mapMemory()) = {};
+			frame.cullObjects = 0u;
+			for(gfx::StorageSet &set : frame.cullSets) set.clean();
+		}
+		CullCounters &counters = *static_cast<CullCounters*>(frame.cull.mapMemory());
+		cullObjects = reinterpret_cast<CullObject*>(&counters + 1);
+		// An object is occluded when it has hidden meshlets and none drawn
+		const std::uint32_t occludedObjects = std::uint32_t(std::count_if(cullObjects, cullObjects + frame.cullObjects,
+			[](const CullObject &obj) { return obj.occluded && !obj.visible; }));
+		cull_stats = { frame.meshlets,
+			counters.drawCounts[0] + counters.drawCounts[1] + counters.lateDrawCounts[0] + counters.lateDrawCounts[1],
+			counters.frustumCulled, counters.backfaceCulled, counters.occludedMeshlets, occludedObjects, counters.occludedTriangles };
+		arenaTriangles = counters.drawnTriangles;
+		counters = {};
+	}
+
+	// Objects of the arenas, numbered by their first instance. Their meshlets are numbered arena by arena for culling.
+	std::array<std::uint32_t, 2> firstObjects, objectCounts, meshletCounts;
+	static_assert(std::tuple_size_v<decltype(arenas)> == std::size(CullCounters {}.drawCounts));
+	for(std::size_t a = 0; a < arenas.size(); ++a) {
+		firstObjects[a] = drawn;
+		meshletCounts[a] = 0u;
+		for(const Object &obj : objects) if(obj.arena == &arenas[a] && obj.uploaded <= ready) {
+			// Every level indexes the vertices of the range of the full resolution
+			const std::size_t l = drawnLevel(obj, ready);
+			const RangeGeometry::Level &level = objectLevel(obj, l);
+			const gfx::GeometryArena::Range &range = levelRange(obj, l);
+			constants[drawn] = drawnConstants(obj);
+			commands[drawn] = { level.indexCount, 1u, range.firstIndex + level.firstIndex, std::int32_t(obj.range.firstVertex), drawn };
+			if(cullObjects) cullObjects[drawn] = { range.firstMeshlet + level.firstMeshlet, level.meshletCount, meshletCounts[a],
+				range.firstIndex, std::int32_t(obj.range.firstVertex), drawn, 0u, 0u };
+			else arenaTriangles += level.indexCount / 3u;
+			meshletCounts[a] += level.meshletCount;
+			++ drawn;
+		}
+		objectCounts[a] = drawn - firstObjects[a];
+	}
+	// Culled triangles of the arenas are only known once the previous submit is done, the other objects are drawn whole
+	triangle_stats = { 0u, arenaTriangles };
+	for(const Object &obj : objects) {
+		triangle_stats.loaded += obj.drawnIndices() / 3u;
+		if(!obj.arena && obj.uploaded <= ready) triangle_stats.drawn += obj.drawnIndices() / 3u;
+	}
+	if(gpu_culling) {
+		frame.meshlets = meshletCounts[0] + meshletCounts[1];
+		frame.cullObjects = drawn;
+		// Room for the draws of both phases
+		if(frame.meshlets > frame.drawCapacity) {
+			frame.drawCapacity = std::max({ std::size_t(frame.meshlets), 2u * frame.drawCapacity, std::size_t(1u << 10) });
+			frame.draws.init(device, 2u * sizeof(VkDrawIndexedIndirectCommand) * frame.drawCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			frame.hidden.init(device, sizeof(std::uint32_t) * frame.drawCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			for(gfx::StorageSet &set : frame.cullSets) set.clean();
+		}
+		for(std::size_t a = 0; a < arenas.size(); ++a)
+			if(meshletCounts[a] && (!frame.cullSets[a] || frame.cullGenerations[a] != arenas[a].meshletGeneration())) {
+				const VkBuffer buffers[] { arenas[a].getMeshletBuffer(), frame.cull, frame.draws, frame.hidden };
+				frame.cullSets[a].init(device, cullLayout, buffers);
+				frame.cullGenerations[a] = arenas[a].meshletGeneration();
+			}
+	}
+
+	// Meshlets of the arenas culled by a phase of cull.comp, as seen from view for the occlusion
+	const auto cullMeshlets = [&](const std::uint32_t phase, const bool occlusion, const Camera &view) {
+		cmdBuffs[i]
+			.bindPipeline(cullPipeline)
+			.bindDescriptorSet(cullPipeline, descriptorPool[i])
+			.bindDescriptorSet(cullPipeline, pyramid.getSet(), 2u);
+		for(std::uint32_t a = 0; a < arenas.size(); ++a) if(meshletCounts[a]) {
+			const CullPass pass { firstObjects[a], objectCounts[a], meshletCounts[a], a, a ? meshletCounts[0] : 0u, frame.meshlets,
+				phase, occlusion, view.center, view.u, view.v, view.w };
+			cmdBuffs[i]
+				.bindDescriptorSet(cullPipeline, frame.cullSets[a], 1u)
+				.pushConstants(cullPipeline, sizeof(pass), &pass)
+				.dispatch((meshletCounts[a] + 63u) / 64u);
+		}
+	};
+	// One indirect draw per arena, the objects are told apart by their first instance. With culling there is an
+	// indirect draw per meshlet left, up to all the meshlets of the arena, the late draws are the ones of the second phase.
+	// Without drawIndirectFirstInstance the commands are drawn directly, still without binding anything between them.
+	const auto drawArenas = [&](const bool late) {
+		const VkPhysicalDeviceFeatures &features = device.getFeatures();
+		for(std::size_t a = 0; a < arenas.size(); ++a) {
+			const std::uint32_t first = firstObjects[a], end = first + objectCounts[a];
+			if(end == first) continue;
+			const gfx::Pipeline &p = a ? compactPipeline : pipeline;
+			cmdBuffs[i]
+				.bindPipeline(p)
+				.bindDescriptorSet(p, descriptorPool[i])
+				.bindDescriptorSet(p, frame.set, 1u)
+				.bindVertexBuffers(arenas[a].getVertexBuffers())
+				.bindIndexBuffer(arenas[a].getIndexBuffer());
+			if(gpu_culling)
+				cmdBuffs[i].drawIndexedIndirectCount(frame.draws,
+					sizeof(VkDrawIndexedIndirectCommand) * ((late ? frame.meshlets : 0u) + (a ? meshletCounts[0] : 0u)), frame.cull,
+					(late ? offsetof(CullCounters, lateDrawCounts) : offsetof(CullCounters, drawCounts)) + sizeof(std::uint32_t) * a,
+					meshletCounts[a]);
+			else if(features.drawIndirectFirstInstance)
+				cmdBuffs[i].drawIndexedIndirect(frame.buffer, sizeof(ObjectConstants) * frame.capacity + sizeof(VkDrawIndexedIndirectCommand) * first,
+					end - first, features.multiDrawIndirect);
+			else for(std::uint32_t d = first; d < end; ++d)
+				cmdBuffs[i].drawIndexed(commands[d].indexCount, 1u, commands[d].firstIndex, d, commands[d].vertexOffset);
+		}
+	};
+
+	cmdBuffs[i].begin();
+	const gfx::SemaphoreSubmit uploads = staging.acquire(cmdBuffs[i], ready);
+	// Smooth normals asked for by pulled vertices, computed once the arrays are uploaded like the draws wait for them
+	for(Object &obj : objects) if(obj.vertexNormalsPending && obj.uploaded <= ready) {
+		recordVertexNormals(cmdBuffs[i], obj);
+		obj.vertexNormalsPending = false;
+		obj.vertexNormalsReady = true;
+	}
+	// Meshlets of the arenas off screen, facing away or hidden in the pyramid of a previous frame are dropped, the others
+	// become the indirect draws of their arena
+	const bool occlusion = hiz_culling && frame.meshlets;
+	if(gpu_culling && frame.meshlets) {
+		// The pyramid is read in the general layout, even when there is nothing to test against yet
+		if(!pyramid_cam) cmdBuffs[i].layoutBarrier(pyramid.getImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0u, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		cullMeshlets(0u, occlusion && pyramid_cam, pyramid_cam ? *pyramid_cam : cam);
+		// The draws read the commands and their count, the second phase the hidden meshlets and the host the counters
+		// once the submit is done
+		cmdBuffs[i].memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT);
+	}
+	cmdBuffs[i]
+		.beginRenderPass(renderPass, swapchain, i)
+			.setViewport(swapchain.getExtent());
+		drawArenas(false);
+		// Streamed and pulled objects have their own buffers, they are drawn grouped by pipeline
+		std::vector<const gfx::Pipeline*> pipelines { &pipeline };
+		for(const gfx::Pipeline &p : pulledPipelines) pipelines.push_back(&p);
+		for(const gfx::Pipeline *p : pipelines) {
+			bool bound = false;
+			for(const Object &obj : objects) if(!obj.arena && obj.drawnIndices() && obj.uploaded <= ready && &objectPipeline(obj) == p) {
+				if(!bound) cmdBuffs[i]
+					.bindPipeline(*p)
+					.bindDescriptorSet(*p, descriptorPool[i]);
+				bound = true;
+				std::uint32_t instance = 0u;
+				if(obj.format == VertexFormat::PULLED) {
+					const ObjectConstants pushed = drawnConstants(obj);
+					cmdBuffs[i]
+						.pushConstants(*p, sizeof(pushed), &pushed)
+						.bindDescriptorSet(*p, obj.meshArraySet, 1u);
+				} else {
+					constants[instance = drawn++] = drawnConstants(obj);
+					cmdBuffs[i]
+						.bindDescriptorSet(*p, frame.set, 1u)
+						.bindVertexBuffers(obj.vertexBuffers);
+				}
+				cmdBuffs[i]
+					.bindIndexBuffer(obj.indexBuffer)
+					.drawIndexed(obj.drawnIndices(), 1, 0, instance);
+			}
+		}
+	cmdBuffs[i].endRenderPass();
+	// The pyramid is built from the depth drawn so far, the meshlets it no longer hides are drawn over it. It stays for
+	// the first phase of the next frame.
+	if(occlusion) {
+		cmdBuffs[i].layoutBarrier(depthImage.getImage(), VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		pyramid.record(cmdBuffs[i]);
+		cullMeshlets(1u, true, cam);
+		cmdBuffs[i]
+			.memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT)
+			.layoutBarrier(depthImage.getImage(), VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0u,
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
+			.beginRenderPass(renderPass, swapchain, i, true)
+				.setViewport(swapchain.getExtent());
+			drawArenas(true);
+		cmdBuffs[i].endRenderPass();
+		pyramid_cam = cam;
+	}
+	cmdBuffs[i].end();
+	return uploads;
+}
+
 void initDevice() {
 	PRINT_INFO("Using Physical Device:", gpu_names[chosenGPU]);
+	stage_timer.reset();
 	device.init(window, gpus[chosenGPU]);
+	logStage("Device");
 	swapchain.init(device, window);
 	depthImage.init(device, swapchain.getExtent());
 	renderPass.init(device, swapchain, depthImage);
-	descriptorPool.addUniformBuffer(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(cam));
+	logStage("Swapchain and render pass");
+	descriptorPool.addUniformBuffer(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, sizeof(cam));
 	descriptorPool.init(device, renderPass.size());
-	pipeline.init(device,
-		gfx::Shader(device, SHADER_DIR "/test.vert.spv"),
-		gfx::Shader(device, SHADER_DIR "/test.frag.spv"),
-		descriptorPool,
-		renderPass
-	);
+	staging.init(device, VkDeviceSize(64) << 20);
+	arenas[0].init(device, staging, gfx::VertexLayout::STRIDES);
+	arenas[1].init(device, staging, gfx::CompactVertexLayout::STRIDES);
+	const gfx::Shader vertexShader(device, shaders::test_vert);
+	const gfx::Shader fragmentShader(device, shaders::test_frag);
+	// Objects of the full and compact formats read their constants in the objects of the frame
+	frameObjectsLayout.init(device, 1u, VK_SHADER_STAGE_VERTEX_BIT);
+	pipeline.init(device, vertexShader, fragmentShader, descriptorPool, renderPass,
+		gfx::VertexLayout::inputState(), nullptr, 0u, frameObjectsLayout);
+	// The compact pipeline decodes the normals in the vertex shader
+	const VkBool32 compact = VK_TRUE;
+	const VkSpecializationMapEntry compactEntry {
+		.constantID = 0u,
+		.offset = 0u,
+		.size = sizeof(compact)
+	};
+	const VkSpecializationInfo compactConstants {
+		.mapEntryCount = 1u,
+		.pMapEntries = &compactEntry,
+		.dataSize = sizeof(compact),
+		.pData = &compact
+	};
+	compactPipeline.init(device, vertexShader, fragmentShader, descriptorPool, renderPass,
+		gfx::CompactVertexLayout::inputState(), &compactConstants, 0u, frameObjectsLayout);
+	// Vertex pulling pipelines have no vertex input, their shader is specialized for the arity of each mesh type
+	meshArrayLayout.init(device, MESH_ARRAY_COUNT, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+	const gfx::Shader pulledShader(device, shaders::pulled_vert);
+	const gfx::Shader cornerNormalShader(device, shaders::corner_normals_comp);
+	const gfx::Shader normalizeShader(device, shaders::normalize_comp);
+	const VkPipelineVertexInputStateCreateInfo noVertexInput {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0u,
+		.vertexBindingDescriptionCount = 0u,
+		.pVertexBindingDescriptions = nullptr,
+		.vertexAttributeDescriptionCount = 0u,
+		.pVertexAttributeDescriptions = nullptr
+	};
+	constexpr std::uint32_t arities[] { TriMesh::ARITY, QuadMesh::ARITY, Mesh::ARITY };
+	static_assert(std::size(arities) == std::variant_size_v<AnyMesh>);
+	for(std::size_t i = 0; i < pulledPipelines.size(); ++i) {
+		const VkSpecializationMapEntry arityEntry {
+			.constantID = 0u,
+			.offset = 0u,
+			.size = sizeof(std::uint32_t)
+		};
+		const VkSpecializationInfo arityConstants {
+			.mapEntryCount = 1u,
+			.pMapEntries = &arityEntry,
+			.dataSize = sizeof(std::uint32_t),
+			.pData = &arities[i]
+		};
+		pulledPipelines[i].init(device, pulledShader, fragmentShader, descriptorPool, renderPass,
+			noVertexInput, &arityConstants, sizeof(ObjectConstants), meshArrayLayout);
+		cornerNormalPipelines[i].init(device, cornerNormalShader, { meshArrayLayout }, sizeof(std::uint32_t), &arityConstants);
+	}
+	normalizePipeline.init(device, normalizeShader, { meshArrayLayout }, sizeof(std::uint32_t));
+	// Meshlet culling writes a command per meshlet left, drawn with the count it writes
+	const VkPhysicalDeviceFeatures &features = device.getFeatures();
+	gpu_culling = device.hasDrawIndirectCount() && features.multiDrawIndirect && features.drawIndirectFirstInstance;
+	// The first phase tests the pyramid of the previous frame, the second one the pyramid of the depth drawn by the first
+	hiz_culling = gpu_culling && depthImage.isSampled();
+	pyramid_cam.reset();
+	if(gpu_culling) {
+		const gfx::Shader cullShader(device, shaders::cull_comp);
+		const gfx::Shader hizShader(device, shaders::hiz_comp);
+		pyramid.init(device, hizShader, depthImage, swapchain.getExtent());
+		cullLayout.init(device, 4u, VK_SHADER_STAGE_COMPUTE_BIT);
+		cullPipeline.init(device, cullShader, { descriptorPool.getLayout(), cullLayout, pyramid.getLayout() }, sizeof(CullPass));
+	}
+	PRINT_INFO("Meshlet culling", !gpu_culling ? "unsupported, objects are drawn whole"
+		: hiz_culling ? "on the GPU with occlusion" : "on the GPU, the depth cannot be sampled for occlusion");
+	logStage("Pipeline");
 	gui.init(instance, device, swapchain);
-	for(Object &obj : objects) obj.vertexBuffer.init(device, sizeof(gfx::Vertex) * obj.nfacet_corners());
-	fillVertexBuffer();
+	logStage("GUI");
+	for(Object &obj : objects) initBuffers(obj);
+	logStage("Vertex buffers");
 	cmdBuffs.init(device);
-	initCmdBuffs();
-	uniCmdBuffs.init(device);
-	uniCmdBuffs.resize(renderPass.size());
+	cmdBuffs.resize(renderPass.size());
 	for(gfx::Semaphore &s : imageAvailable) s.init(device);
 	for(gfx::Semaphore &s : renderFinished) s.init(device);
 	cmdSubmitted.resize(cmdBuffs.size());
 	for(gfx::Fence &f : cmdSubmitted) f.init(device, true);
+	frameObjects.resize(cmdBuffs.size());
+	logStage("Command buffers and synchronization");
 }
 
 void init() {
 	// Vulkan instance
 	instance.init(APP_NAME, gfx::Window::getRequiredExtensions());
+	logStage("Vulkan instance");
 
 	// Window
 	window.init(instance, APP_NAME,
@@ -345,6 +1404,7 @@ void init() {
 	window.setMouseButtonCallback(mouseButtonCallback);
 	window.setCursorPosCallback(cursorPosCallback);
 	window.setKeyCallback(keyCallback);
+	logStage("Window");
 
 	// GPUs list
 	gpus = gfx::Device::getAvailableDevices(instance, window);
@@ -360,6 +1420,7 @@ void init() {
 		*(ind++) = *(name++);
 		if(!strcmp(gpu_names[i], Config::data.preferred_gpu)) chosenGPU = i;
 	}
+	logStage("GPUs list");
 
 	// Imgui init
 	ImGui::CreateContext();
@@ -372,6 +1433,7 @@ void init() {
 	ImGui::PushStyleVar(ImGuiStyleVar_ScrollbarSize, 16.f);
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(5, 5));
   	ImGui_ImplGlfw_InitForVulkan(window, true);
+	logStage("ImGui");
 
 	// Init device
 	initDevice();
@@ -390,12 +1452,14 @@ void updateSwapchain() {
 	swapchain.recreate(device, window);
 	depthImage.recreate(device, swapchain.getExtent());
 	renderPass.initFramebuffers(swapchain, depthImage);
+	if(gpu_culling) pyramid.recreate(depthImage, swapchain.getExtent());
+	pyramid_cam.reset();
 	gui.update(swapchain);
 	//TODO: Maybe descriptor pool should be resized
-	initCmdBuffs();
-	uniCmdBuffs.resize(renderPass.size());
+	cmdBuffs.resize(renderPass.size());
 	cmdSubmitted.resize(cmdBuffs.size());
 	for(gfx::Fence &f : cmdSubmitted) if(!f) f.init(device, true);
+	frameObjects.resize(cmdBuffs.size());
 	swapchain.cleanOld();
 }
 
@@ -415,20 +1479,32 @@ void loop() {
 			initDevice();
 			continue;
 		}
-		// TODO: Look at secondary command buffers instead of OT
-		uniCmdBuffs[imIndex].beginOT()
-			.updateBuffer(descriptorPool.getBuffer(), descriptorPool.getOffset(imIndex, 0), sizeof(cam), &cam)
-			.bufferBarrier(descriptorPool.getBuffer(), descriptorPool.getOffset(imIndex, 0), sizeof(cam))
-		.end();
-		gfx::CommandBuffer cmds[] { uniCmdBuffs[imIndex], cmdBuffs[imIndex], gui.getCommand(swapchain, imIndex) };
-		gfx::CommandBuffer::submit(cmds, std::size(cmds),
-								device.getGraphicsQueue(),
-								imageAvailable[currentFrame], renderFinished[currentFrame],
+		updatePendingObjects();
+		updateStreams();
+		updateLods();
+		// Uploads of the frame are submitted together. New objects are drawn once their uploads are done, streamed
+		// objects wait for their last chunk to keep growing without flickering, as well as their full mesh when they
+		// finish, and arenas for the copy of their last growth.
+		staging.flush();
+		gfx::UploadToken ready = staging.readyToken();
+		for(Object &obj : objects) if(obj.stream || obj.streamFinished) {
+			ready = std::max(ready, obj.uploaded);
+			obj.streamFinished = false;
+		}
+		for(const gfx::GeometryArena &arena : arenas) ready = std::max(ready, arena.grown());
+		const gfx::SemaphoreSubmit uploads = recordCmdBuff(imIndex, ready);
+		// The previous submit of this image is done, the host writes its camera in place
+		descriptorPool.updateUniform(imIndex, 0, &cam, sizeof(cam));
+		gfx::CommandBuffer cmds[] { cmdBuffs[imIndex], gui.getCommand(swapchain, imIndex) };
+		gfx::CommandBuffer::submit(device, cmds, std::size(cmds), device.getGraphicsQueue(),
+								{ { imageAvailable[currentFrame], 0u, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }, uploads },
+								{ { renderFinished[currentFrame] }, staging.graphicsSignal() },
 								cmdSubmitted[imIndex]);
 		const VkResult result = swapchain.presentImage(imIndex, device.getPresentQueue(), renderFinished[currentFrame]);
 		if(window.isFramebufferResized() || result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
 			updateSwapchain();
 		else if(result != VK_SUCCESS) THROW_ERROR("failed to present swapchain image!");
+		if(!rendered_frames) logTiming("First frame presented", 1e3 * startup_timer.elapsed(), "ms after startup");
 		++ rendered_frames;
 		currentFrame = (currentFrame + 1) % 20;
 	}
@@ -436,14 +1512,36 @@ void loop() {
 
 void cleanDevice() {
 	device.waitIdle();
+	staging.clean();
+	for(gfx::GeometryArena &arena : arenas) arena.clean();
+	frameObjects.clear();
 	cmdSubmitted.clear();
 	for(gfx::Semaphore &s : renderFinished) s.clean();
 	for(gfx::Semaphore &s : imageAvailable) s.clean();
-	uniCmdBuffs.clear();
 	cmdBuffs.clear();
-	for(Object &obj : objects) obj.vertexBuffer.clean();
+	for(Object &obj : objects) {
+		for(gfx::VertexBuffer &buffer : obj.vertexBuffers) buffer.clean();
+		obj.meshArraySet.clean();
+		for(gfx::StorageBuffer &buffer : obj.meshArrays) buffer.clean();
+		obj.indexBuffer.clean();
+		obj.arena = nullptr;
+		obj.range = {};
+		obj.lodRange = {};
+		obj.vertexCapacities.fill(0u);
+		obj.meshArrayCapacities.fill(0u);
+		obj.indexCapacity = 0u;
+	}
 	gui.clean();
+	cullPipeline.clean();
+	cullLayout.clean();
+	pyramid.clean();
+	normalizePipeline.clean();
+	for(gfx::ComputePipeline &p : cornerNormalPipelines) p.clean();
+	for(gfx::Pipeline &p : pulledPipelines) p.clean();
+	meshArrayLayout.clean();
+	compactPipeline.clean();
 	pipeline.clean();
+	frameObjectsLayout.clean();
 	descriptorPool.clean();
 	renderPass.clean();
 	depthImage.clean();
@@ -460,15 +1558,25 @@ void clean() {
 }
 
 int main(int argc, const char* argv[]) {
+	for(int i = 1; i < argc; ++i) print_timings |= !strcmp(argv[i], "-t") || !strcmp(argv[i], "--timings");
 	Config::load();
+	clampPreferences();
 	glfwInit();
 
 	Lua::new_state();
+	logStage("Config, GLFW and Lua");
+	PRINT_INFO("Geometry kernels use", simd::name(simd::active()));
 
+	// Every file is read on its own thread while Vulkan is initialized,
+	// files following --stream are displayed while they are being read
+	bool stream = false;
 	for(int i = 1; i < argc; ++i) {
-		objects.emplace_back(readMesh(argv[i]));
-		objects.back().name = std::filesystem::path(argv[i]).filename().replace_extension();
-		std::fill_n(objects.back().surfaceColor, 3, 0.65f);
+		if(!strcmp(argv[i], "-s") || !strcmp(argv[i], "--stream")) {
+			stream = true;
+			continue;
+		}
+		if(!strcmp(argv[i], "-t") || !strcmp(argv[i], "--timings")) continue;
+		openMesh(argv[i], stream);
 	}
 
 	try {
@@ -0,0 +1,63 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Jobs running at the same time that split the hardware threads, see ThreadShare
+inline std::atomic<std::size_t> sharedJobs = 0;
+
+// Threads of a parallel loop, the hardware threads split between the jobs running at the same time.
+// It changes as jobs start and end, so a loop sizing per thread data must pass the count it used to parallelRanges.
+inline std::size_t threadCount() {
+	const std::size_t jobs = std::max<std::size_t>(1, sharedJobs.load(std::memory_order_relaxed));
+	return std::max<std::size_t>(1, std::thread::hardware_concurrency() / jobs);
+}
+
+// Scope of a job run by its own thread next to others, like the read of a file while other files are read. The parallel
+// loops of the jobs get their share of the hardware threads instead of starting them all each.
+class ThreadShare {
+public:
+	ThreadShare() { ++ sharedJobs; }
+	~ThreadShare() { -- sharedJobs; }
+	ThreadShare(const ThreadShare&) = delete;
+	ThreadShare& operator=(const ThreadShare&) = delete;
+};
+
+// Triangles handled by a thread at least, so that small meshes do not pay for thread creation
+constexpr std::size_t MIN_TRIANGLES_PER_THREAD = 1u << 14;
+
+// Split [0, n) in `nthreads` contiguous ranges and call fun(t, begin, end) for each range t on its own thread.
+// The first exception thrown by a range is rethrown once every thread has joined.
+template<typename Fun>
+void parallelRanges(const std::size_t n, const Fun &fun, std::size_t nthreads = threadCount()) {
+	nthreads = std::max<std::size_t>(1, std::min(nthreads, n));
+	if(nthreads == 1) {
+		fun(std::size_t(0), std::size_t(0), n);
+		return;
+	}
+	std::vector<std::exception_ptr> errors(nthreads);
+	const auto run = [&](const std::size_t t) {
+		try { fun(t, t * n / nthreads, (t+1) * n / nthreads); }
+		catch(...) { errors[t] = std::current_exception(); }
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(nthreads-1);
+	for(std::size_t t = 1; t < nthreads; ++t) threads.emplace_back(run, t);
+	run(0);
+	for(std::thread &thread : threads) thread.join();
+	for(const std::exception_ptr &e : errors) if(e) std::rethrow_exception(e);
+}
+
+template<typename Fun>
+void parallelFor(const std::size_t n, const Fun &fun) {
+	parallelRanges(n, [&](std::size_t, const std::size_t begin, const std::size_t end) {
+		for(std::size_t i = begin; i < end; ++i) fun(i);
+	});
+}
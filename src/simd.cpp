@@ -0,0 +1,342 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#include "simd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+	#define SIMD_X86
+	#include <immintrin.h>
+	#define TARGET_SSE42 __attribute__((target("sse4.2")))
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static_assert(sizeof(vec3) == 3 * sizeof(double) && sizeof(vec3f) == 3 * sizeof(float));
+
+namespace simd {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double TAN_PI_8 = 0.41421356237309504880;
+// Minimax polynomial of atan on [-tan(pi/8), tan(pi/8)]
+constexpr double ATAN_C0 = 8.05374449538e-2, ATAN_C1 = 1.38776856032e-1, ATAN_C2 = 1.99777106478e-1, ATAN_C3 = 3.33329491539e-1;
+
+// Every implementation evaluates the same operations in the same order (there is no FMA),
+// so that the results do not depend on the instruction set.
+namespace scalar {
+
+// atan2(s, c) for s >= 0
+inline double angle(const double s, const double c) {
+	const double ac = std::abs(c);
+	const double lo = std::min(s, ac), hi = std::max(s, ac);
+	double t = hi > 0. ? lo / hi : 0.;
+	double offset = 0.;
+	if(t > TAN_PI_8) {
+		t = (t - 1.) / (t + 1.);
+		offset = PI / 4.;
+	}
+	const double z = t * t;
+	double a = offset + (((((ATAN_C0 * z - ATAN_C1) * z + ATAN_C2) * z - ATAN_C3) * z) * t + t);
+	if(s > ac) a = PI / 2. - a;
+	if(c < 0.) a = PI - a;
+	return a;
+}
+
+void cornerNormals(const vec3* P, const std::uint32_t* prev, const std::uint32_t* cur, const std::uint32_t* next,
+	const std::size_t n, const bool weighted, vec3* out) {
+	for(std::size_t i = 0; i < n; ++i) {
+		const vec3 &p = P[cur[i]];
+		const vec3 a = P[prev[i]] - p;
+		const vec3 b = P[next[i]] - p;
+		const vec3 normal = cross(a, b);
+		const double s = normal.norm();
+		out[i] = s > 0. ? ((weighted ? angle(s, a * b) : 1.) / s) * normal : vec3(0.);
+	}
+}
+
+void normalize(vec3* v, const std::size_t n) {
+	for(std::size_t i = 0; i < n; ++i) {
+		const double l = v[i].norm();
+		if(l > 0.) v[i] *= 1. / l;
+	}
+}
+
+void convertPoints(const vec3* P, const std::uint32_t* ids, const std::size_t n, vec3f* out) {
+	for(std::size_t i = 0; i < n; ++i) out[i] = P[ids ? ids[i] : i];
+}
+
+}
+
+#ifdef SIMD_X86
+
+// Two lanes of doubles
+namespace sse42 {
+
+TARGET_SSE42 inline void gather(const vec3* P, const std::size_t i0, const std::size_t i1, __m128d &x, __m128d &y, __m128d &z) {
+	const double* p0 = reinterpret_cast<const double*>(P + i0);
+	const double* p1 = reinterpret_cast<const double*>(P + i1);
+	x = _mm_set_pd(p1[0], p0[0]);
+	y = _mm_set_pd(p1[1], p0[1]);
+	z = _mm_set_pd(p1[2], p0[2]);
+}
+
+// Two consecutive vec3 to and from lanes
+TARGET_SSE42 inline void load(const vec3* v, __m128d &x, __m128d &y, __m128d &z) {
+	const double* d = reinterpret_cast<const double*>(v);
+	const __m128d r0 = _mm_loadu_pd(d), r1 = _mm_loadu_pd(d + 2), r2 = _mm_loadu_pd(d + 4);
+	x = _mm_shuffle_pd(r0, r1, 2);
+	y = _mm_shuffle_pd(r0, r2, 1);
+	z = _mm_shuffle_pd(r1, r2, 2);
+}
+
+TARGET_SSE42 inline void store(vec3* v, const __m128d x, const __m128d y, const __m128d z) {
+	double* d = reinterpret_cast<double*>(v);
+	_mm_storeu_pd(d, _mm_unpacklo_pd(x, y));
+	_mm_storeu_pd(d + 2, _mm_shuffle_pd(z, x, 2));
+	_mm_storeu_pd(d + 4, _mm_unpackhi_pd(y, z));
+}
+
+TARGET_SSE42 inline __m128d angle(const __m128d s, const __m128d c) {
+	const __m128d one = _mm_set1_pd(1.);
+	const __m128d ac = _mm_andnot_pd(_mm_set1_pd(-0.), c);
+	const __m128d hi = _mm_max_pd(s, ac);
+	__m128d t = _mm_and_pd(_mm_div_pd(_mm_min_pd(s, ac), hi), _mm_cmpgt_pd(hi, _mm_setzero_pd()));
+	const __m128d reduce = _mm_cmpgt_pd(t, _mm_set1_pd(TAN_PI_8));
+	t = _mm_blendv_pd(t, _mm_div_pd(_mm_sub_pd(t, one), _mm_add_pd(t, one)), reduce);
+	const __m128d offset = _mm_and_pd(reduce, _mm_set1_pd(PI / 4.));
+	const __m128d z = _mm_mul_pd(t, t);
+	__m128d p = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(ATAN_C0), z), _mm_set1_pd(ATAN_C1));
+	p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(ATAN_C2));
+	p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(ATAN_C3));
+	p = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(p, z), t), t);
+	__m128d a = _mm_add_pd(offset, p);
+	a = _mm_blendv_pd(a, _mm_sub_pd(_mm_set1_pd(PI / 2.), a), _mm_cmpgt_pd(s, ac));
+	return _mm_blendv_pd(a, _mm_sub_pd(_mm_set1_pd(PI), a), _mm_cmplt_pd(c, _mm_setzero_pd()));
+}
+
+TARGET_SSE42 void cornerNormals(const vec3* P, const std::uint32_t* prev, const std::uint32_t* cur, const std::uint32_t* next,
+	const std::size_t n, const bool weighted, vec3* out) {
+	std::size_t i = 0;
+	for(; i + 2 <= n; i += 2) {
+		__m128d px, py, pz, ax, ay, az, bx, by, bz;
+		gather(P, cur[i], cur[i+1], px, py, pz);
+		gather(P, prev[i], prev[i+1], ax, ay, az);
+		gather(P, next[i], next[i+1], bx, by, bz);
+		ax = _mm_sub_pd(ax, px); ay = _mm_sub_pd(ay, py); az = _mm_sub_pd(az, pz);
+		bx = _mm_sub_pd(bx, px); by = _mm_sub_pd(by, py); bz = _mm_sub_pd(bz, pz);
+		const __m128d nx = _mm_sub_pd(_mm_mul_pd(ay, bz), _mm_mul_pd(az, by));
+		const __m128d ny = _mm_sub_pd(_mm_mul_pd(az, bx), _mm_mul_pd(ax, bz));
+		const __m128d nz = _mm_sub_pd(_mm_mul_pd(ax, by), _mm_mul_pd(ay, bx));
+		const __m128d s = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, nx), _mm_mul_pd(ny, ny)), _mm_mul_pd(nz, nz)));
+		__m128d w;
+		if(weighted) {
+			const __m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ax, bx), _mm_mul_pd(ay, by)), _mm_mul_pd(az, bz));
+			w = _mm_div_pd(angle(s, c), s);
+		} else w = _mm_div_pd(_mm_set1_pd(1.), s);
+		const __m128d valid = _mm_cmpgt_pd(s, _mm_setzero_pd());
+		store(out + i, _mm_and_pd(_mm_mul_pd(w, nx), valid), _mm_and_pd(_mm_mul_pd(w, ny), valid), _mm_and_pd(_mm_mul_pd(w, nz), valid));
+	}
+	scalar::cornerNormals(P, prev + i, cur + i, next + i, n - i, weighted, out + i);
+}
+
+TARGET_SSE42 void normalize(vec3* v, const std::size_t n) {
+	std::size_t i = 0;
+	for(; i + 2 <= n; i += 2) {
+		__m128d x, y, z;
+		load(v + i, x, y, z);
+		const __m128d l = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z)));
+		const __m128d inv = _mm_div_pd(_mm_set1_pd(1.), l);
+		const __m128d valid = _mm_cmpgt_pd(l, _mm_setzero_pd());
+		store(v + i,
+			_mm_blendv_pd(x, _mm_mul_pd(x, inv), valid),
+			_mm_blendv_pd(y, _mm_mul_pd(y, inv), valid),
+			_mm_blendv_pd(z, _mm_mul_pd(z, inv), valid));
+	}
+	scalar::normalize(v + i, n - i);
+}
+
+}
+
+// Four lanes of doubles
+namespace avx2 {
+
+// The gather instructions are slower than loading the points one by one, x and y of each point are loaded together
+// then the pairs are transposed
+TARGET_AVX2 inline void gather(const vec3* P, const std::uint32_t* ids, __m256d &x, __m256d &y, __m256d &z) {
+	const double* p0 = reinterpret_cast<const double*>(P + ids[0]);
+	const double* p1 = reinterpret_cast<const double*>(P + ids[1]);
+	const double* p2 = reinterpret_cast<const double*>(P + ids[2]);
+	const double* p3 = reinterpret_cast<const double*>(P + ids[3]);
+	const __m256d xy02 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p0)), _mm_loadu_pd(p2), 1);
+	const __m256d xy13 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p1)), _mm_loadu_pd(p3), 1);
+	x = _mm256_unpacklo_pd(xy02, xy13);
+	y = _mm256_unpackhi_pd(xy02, xy13);
+	z = _mm256_set_pd(p3[2], p2[2], p1[2], p0[2]);
+}
+
+// Four consecutive vec3 to and from lanes
+TARGET_AVX2 inline void load(const vec3* v, __m256d &x, __m256d &y, __m256d &z) {
+	const double* d = reinterpret_cast<const double*>(v);
+	const __m256d r0 = _mm256_loadu_pd(d), r1 = _mm256_loadu_pd(d + 4), r2 = _mm256_loadu_pd(d + 8);
+	const __m256d t0 = _mm256_permute2f128_pd(r0, r1, 0x30); // x0 y0 x2 y2
+	const __m256d t1 = _mm256_permute2f128_pd(r0, r2, 0x21); // z0 x1 z2 x3
+	const __m256d t2 = _mm256_permute2f128_pd(r1, r2, 0x30); // y1 z1 y3 z3
+	x = _mm256_shuffle_pd(t0, t1, 0xA);
+	y = _mm256_shuffle_pd(t0, t2, 0x5);
+	z = _mm256_shuffle_pd(t1, t2, 0xA);
+}
+
+TARGET_AVX2 inline void store(vec3* v, const __m256d x, const __m256d y, const __m256d z) {
+	double* d = reinterpret_cast<double*>(v);
+	const __m256d t0 = _mm256_unpacklo_pd(x, y); // x0 y0 x2 y2
+	const __m256d t1 = _mm256_unpackhi_pd(x, y); // x1 y1 x3 y3
+	const __m256d t2 = _mm256_unpacklo_pd(z, t1); // z0 x1 z2 x3
+	const __m256d t3 = _mm256_unpackhi_pd(t1, z); // y1 z1 y3 z3
+	_mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+	_mm256_storeu_pd(d + 4, _mm256_permute2f128_pd(t3, t0, 0x30));
+	_mm256_storeu_pd(d + 8, _mm256_permute2f128_pd(t2, t3, 0x31));
+}
+
+TARGET_AVX2 inline __m256d angle(const __m256d s, const __m256d c) {
+	const __m256d one = _mm256_set1_pd(1.);
+	const __m256d ac = _mm256_andnot_pd(_mm256_set1_pd(-0.), c);
+	const __m256d hi = _mm256_max_pd(s, ac);
+	__m256d t = _mm256_and_pd(_mm256_div_pd(_mm256_min_pd(s, ac), hi), _mm256_cmp_pd(hi, _mm256_setzero_pd(), _CMP_GT_OQ));
+	const __m256d reduce = _mm256_cmp_pd(t, _mm256_set1_pd(TAN_PI_8), _CMP_GT_OQ);
+	t = _mm256_blendv_pd(t, _mm256_div_pd(_mm256_sub_pd(t, one), _mm256_add_pd(t, one)), reduce);
+	const __m256d offset = _mm256_and_pd(reduce, _mm256_set1_pd(PI / 4.));
+	const __m256d z = _mm256_mul_pd(t, t);
+	__m256d p = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(ATAN_C0), z), _mm256_set1_pd(ATAN_C1));
+	p = _mm256_add_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(ATAN_C2));
+	p = _mm256_sub_pd(_mm256_mul_pd(p, z), _mm256_set1_pd(ATAN_C3));
+	p = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(p, z), t), t);
+	__m256d a = _mm256_add_pd(offset, p);
+	a = _mm256_blendv_pd(a, _mm256_sub_pd(_mm256_set1_pd(PI / 2.), a), _mm256_cmp_pd(s, ac, _CMP_GT_OQ));
+	return _mm256_blendv_pd(a, _mm256_sub_pd(_mm256_set1_pd(PI), a), _mm256_cmp_pd(c, _mm256_setzero_pd(), _CMP_LT_OQ));
+}
+
+TARGET_AVX2 void cornerNormals(const vec3* P, const std::uint32_t* prev, const std::uint32_t* cur, const std::uint32_t* next,
+	const std::size_t n, const bool weighted, vec3* out) {
+	std::size_t i = 0;
+	for(; i + 4 <= n; i += 4) {
+		__m256d px, py, pz, ax, ay, az, bx, by, bz;
+		gather(P, cur + i, px, py, pz);
+		gather(P, prev + i, ax, ay, az);
+		gather(P, next + i, bx, by, bz);
+		ax = _mm256_sub_pd(ax, px); ay = _mm256_sub_pd(ay, py); az = _mm256_sub_pd(az, pz);
+		bx = _mm256_sub_pd(bx, px); by = _mm256_sub_pd(by, py); bz = _mm256_sub_pd(bz, pz);
+		const __m256d nx = _mm256_sub_pd(_mm256_mul_pd(ay, bz), _mm256_mul_pd(az, by));
+		const __m256d ny = _mm256_sub_pd(_mm256_mul_pd(az, bx), _mm256_mul_pd(ax, bz));
+		const __m256d nz = _mm256_sub_pd(_mm256_mul_pd(ax, by), _mm256_mul_pd(ay, bx));
+		const __m256d s = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, nx), _mm256_mul_pd(ny, ny)), _mm256_mul_pd(nz, nz)));
+		__m256d w;
+		if(weighted) {
+			const __m256d c = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ax, bx), _mm256_mul_pd(ay, by)), _mm256_mul_pd(az, bz));
+			w = _mm256_div_pd(angle(s, c), s);
+		} else w = _mm256_div_pd(_mm256_set1_pd(1.), s);
+		const __m256d valid = _mm256_cmp_pd(s, _mm256_setzero_pd(), _CMP_GT_OQ);
+		store(out + i,
+			_mm256_and_pd(_mm256_mul_pd(w, nx), valid),
+			_mm256_and_pd(_mm256_mul_pd(w, ny), valid),
+			_mm256_and_pd(_mm256_mul_pd(w, nz), valid));
+	}
+	scalar::cornerNormals(P, prev + i, cur + i, next + i, n - i, weighted, out + i);
+}
+
+TARGET_AVX2 void normalize(vec3* v, const std::size_t n) {
+	std::size_t i = 0;
+	for(; i + 4 <= n; i += 4) {
+		__m256d x, y, z;
+		load(v + i, x, y, z);
+		const __m256d l = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z)));
+		const __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.), l);
+		const __m256d valid = _mm256_cmp_pd(l, _mm256_setzero_pd(), _CMP_GT_OQ);
+		store(v + i,
+			_mm256_blendv_pd(x, _mm256_mul_pd(x, inv), valid),
+			_mm256_blendv_pd(y, _mm256_mul_pd(y, inv), valid),
+			_mm256_blendv_pd(z, _mm256_mul_pd(z, inv), valid));
+	}
+	scalar::normalize(v + i, n - i);
+}
+
+}
+
+#endif
+
+struct Kernels {
+	decltype(&scalar::cornerNormals) cornerNormals;
+	decltype(&scalar::normalize) normalize;
+	decltype(&scalar::convertPoints) convertPoints;
+};
+
+// Indexed by ISA
+const Kernels KERNELS[] {
+	{ scalar::cornerNormals, scalar::normalize, scalar::convertPoints },
+#ifdef SIMD_X86
+	// The conversion is bound by the memory, no vector version measurably beats the scalar loop
+	{ sse42::cornerNormals, sse42::normalize, scalar::convertPoints },
+	{ avx2::cornerNormals, avx2::normalize, scalar::convertPoints }
+#else
+	{ scalar::cornerNormals, scalar::normalize, scalar::convertPoints },
+	{ scalar::cornerNormals, scalar::normalize, scalar::convertPoints }
+#endif
+};
+
+ISA detect() {
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) return ISA::AVX2;
+	if(__builtin_cpu_supports("sse4.2")) return ISA::SSE42;
+#endif
+	return ISA::SCALAR;
+}
+
+std::atomic<ISA>& current() {
+	static std::atomic<ISA> isa = detected();
+	return isa;
+}
+
+inline const Kernels& kernels() { return KERNELS[int(current().load(std::memory_order_relaxed))]; }
+
+}
+
+ISA detected() {
+	static const ISA isa = detect();
+	return isa;
+}
+
+ISA active() {
+	return current();
+}
+
+void setActive(const ISA isa) {
+	current() = std::min(isa, detected());
+}
+
+const char* name(const ISA isa) {
+	switch(isa) {
+		case ISA::SSE42: return "SSE4.2";
+		case ISA::AVX2: return "AVX2";
+		default: return "scalar";
+	}
+}
+
+void cornerNormals(const vec3* P, const std::uint32_t* prev, const std::uint32_t* cur, const std::uint32_t* next,
+	const std::size_t n, const bool weighted, vec3* out) {
+	kernels().cornerNormals(P, prev, cur, next, n, weighted, out);
+}
+
+void normalize(vec3* v, const std::size_t n) {
+	kernels().normalize(v, n);
+}
+
+void convertPoints(const vec3* P, const std::uint32_t* ids, const std::size_t n, vec3f* out) {
+	kernels().convertPoints(P, ids, n, out);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <maths.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Geometry kernels vectorized for SSE4.2 and AVX2, with a scalar fallback.
+// Arrays stay in the layout of the mesh and of the vertex streams (vec3 of doubles or floats), each kernel gathers a few corners at once
+// in structure of arrays registers (one lane per corner) and writes its results back interleaved.
+// The instruction set is chosen at runtime according to the CPU.
+namespace simd {
+
+enum class ISA { SCALAR, SSE42, AVX2 };
+
+// Elements buffered by the callers between two kernel calls, small enough for the buffers to stay in L1
+constexpr std::size_t CHUNK_SIZE = 1u << 10;
+
+// Best instruction set supported by the CPU
+ISA detected();
+// Instruction set used by the kernels, detected() unless changed by setActive
+ISA active();
+// Use `isa` for the next kernel calls, it is lowered to detected() if the CPU lacks it
+void setActive(ISA isa);
+const char* name(ISA isa);
+
+// Normals of the n corners whose vertex is cur[i] and whose previous and next vertices in their facet
+// are prev[i] and next[i]: cross(P[prev] - P[cur], P[next] - P[cur]) scaled by the corner angle divided
+// by its length when `weighted` is true, unit otherwise. Degenerate corners get a null normal.
+// Angles are approximated with a relative error below 1e-7.
+void cornerNormals(const vec3* P, const std::uint32_t* prev, const std::uint32_t* cur, const std::uint32_t* next,
+	std::size_t n, bool weighted, vec3* out);
+
+// Normalize the n vectors of v in place, null vectors stay null
+void normalize(vec3* v, std::size_t n);
+
+// Convert n points to float: out[i] = P[ids[i]], a null `ids` stands for the identity.
+// Every instruction set runs the scalar loop, the conversion is bound by the memory.
+void convertPoints(const vec3* P, const std::uint32_t* ids, std::size_t n, vec3f* out);
+
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread
+template<typename T, std::size_t N>
+class SPSCQueue {
+	static_assert(N && !(N & (N-1)), "SPSCQueue capacity must be a power of two");
+public:
+	// Producer side, returns false (and leaves item untouched) if the queue is full
+	bool push(T &&item) {
+		const std::size_t t = tail.load(std::memory_order_relaxed);
+		if(t - head.load(std::memory_order_acquire) == N) return false;
+		items[t & (N-1)] = std::move(item);
+		tail.store(t+1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, returns false if the queue is empty
+	bool pop(T &item) {
+		const std::size_t h = head.load(std::memory_order_relaxed);
+		if(h == tail.load(std::memory_order_acquire)) return false;
+		item = std::move(items[h & (N-1)]);
+		head.store(h+1, std::memory_order_release);
+		return true;
+	}
+
+	inline bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+	std::array<T, N> items;
+	alignas(64) std::atomic<std::size_t> head = 0;
+	alignas(64) std::atomic<std::size_t> tail = 0;
+};
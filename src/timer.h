@@ -0,0 +1,21 @@
+// Copyright (C) 2023, Coudert--Osmont Yoann
+// SPDX-License-Identifier: AGPL-3.0-or-later
+// See <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <chrono>
+
+class Timer {
+public:
+	Timer(): start(std::chrono::steady_clock::now()) {}
+
+	inline void reset() { start = std::chrono::steady_clock::now(); }
+	// Elapsed time in seconds
+	inline double elapsed() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};